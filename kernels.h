@@ -0,0 +1,1540 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+
+// MSVC accepts any intrinsic in any function, GCC/Clang need the ISA enabled per function
+#if defined(_MSC_VER)
+#define RASTERIZER_TARGET(isa)
+#else
+#define RASTERIZER_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// GCC 12 before 12.3 reports the _mm512_undefined_* placeholders inside its own AVX-512 intrinsics
+// as uninitialized once they are inlined into a kernel (GCC bug 105593)
+#if defined(__GNUC__) && !defined(__clang__)
+#define RASTERIZER_AVX512_WARNINGS_PUSH _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wuninitialized\"") \
+                                        _Pragma("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+#define RASTERIZER_AVX512_WARNINGS_POP _Pragma("GCC diagnostic pop")
+#else
+#define RASTERIZER_AVX512_WARNINGS_PUSH
+#define RASTERIZER_AVX512_WARNINGS_POP
+#endif
+
+namespace RasterKernels
+{
+    enum class KernelIsa
+    {
+        Auto, // RASTERIZER_ISA environment variable if set, otherwise the best the host supports
+        Scalar,
+        SSE42,
+        AVX2,
+        AVX512
+    };
+
+    // Coverage of a 16x16 tile, row gy is bits [16 * gy, 16 * gy + 16) counted across the words
+    struct Mask256
+    {
+        uint64_t Words[4] = {};
+
+        constexpr Mask256 &operator&=(const Mask256 &other)
+        {
+            for(int i = 0; i < 4; ++i)
+            {
+                Words[i] &= other.Words[i];
+            }
+            return *this;
+        }
+        constexpr Mask256 &operator|=(const Mask256 &other)
+        {
+            for(int i = 0; i < 4; ++i)
+            {
+                Words[i] |= other.Words[i];
+            }
+            return *this;
+        }
+        constexpr Mask256 operator&(const Mask256 &other) const { Mask256 m = *this; return m &= other; }
+        constexpr Mask256 operator|(const Mask256 &other) const { Mask256 m = *this; return m |= other; }
+        constexpr Mask256 operator~() const
+        {
+            Mask256 m;
+            for(int i = 0; i < 4; ++i)
+            {
+                m.Words[i] = ~Words[i];
+            }
+            return m;
+        }
+        constexpr bool operator==(const Mask256 &other) const
+        {
+            return Words[0] == other.Words[0] && Words[1] == other.Words[1] && Words[2] == other.Words[2] && Words[3] == other.Words[3];
+        }
+        constexpr bool operator!=(const Mask256 &other) const { return !(*this == other); }
+    };
+
+    // Smallest mask type holding one bit per pixel of a GridSize x GridSize tile, bit gy * GridSize + gx
+    template <int GridSize> struct TileMaskTraits;
+    template <> struct TileMaskTraits<4>  { using Type = uint16_t; };
+    template <> struct TileMaskTraits<8>  { using Type = uint64_t; };
+    template <> struct TileMaskTraits<16> { using Type = Mask256; };
+
+    template <int GridSize>
+    using TileMask = typename TileMaskTraits<GridSize>::Type;
+
+    template <typename MaskT>
+    constexpr MaskT FullMask()
+    {
+        return static_cast<MaskT>(~MaskT{});
+    }
+
+    template <typename MaskT>
+    constexpr void SetBit(MaskT &mask, int bit)
+    {
+        mask |= static_cast<MaskT>(MaskT(1) << bit);
+    }
+
+    constexpr void SetBit(Mask256 &mask, int bit)
+    {
+        mask.Words[bit >> 6] |= 1ull << (bit & 63);
+    }
+
+    template <typename MaskT>
+    constexpr bool TestBit(const MaskT &mask, int bit)
+    {
+        return (mask >> bit) & 1;
+    }
+
+    constexpr bool TestBit(const Mask256 &mask, int bit)
+    {
+        return (mask.Words[bit >> 6] >> (bit & 63)) & 1;
+    }
+
+    // ORs bits into a coverage word other threads update too. Relaxed, the writers only need the
+    // final value once they have been joined. Skipped when the bits are already set, which is the
+    // common case for tiles inside large triangles.
+    inline void AtomicOr(uint16_t &target, uint16_t bits)
+    {
+#if defined(_MSC_VER)
+        if((*reinterpret_cast<volatile uint16_t *>(&target) & bits) != bits)
+        {
+            _InterlockedOr16(reinterpret_cast<volatile short *>(&target), static_cast<short>(bits));
+        }
+#else
+        if((__atomic_load_n(&target, __ATOMIC_RELAXED) & bits) != bits)
+        {
+            __atomic_fetch_or(&target, bits, __ATOMIC_RELAXED);
+        }
+#endif
+    }
+
+    inline void AtomicOr(uint64_t &target, uint64_t bits)
+    {
+#if defined(_MSC_VER)
+        if((*reinterpret_cast<volatile uint64_t *>(&target) & bits) != bits)
+        {
+            _InterlockedOr64(reinterpret_cast<volatile __int64 *>(&target), static_cast<__int64>(bits));
+        }
+#else
+        if((__atomic_load_n(&target, __ATOMIC_RELAXED) & bits) != bits)
+        {
+            __atomic_fetch_or(&target, bits, __ATOMIC_RELAXED);
+        }
+#endif
+    }
+
+    inline void AtomicOr(Mask256 &target, const Mask256 &bits)
+    {
+        for(int i = 0; i < 4; ++i)
+        {
+            AtomicOr(target.Words[i], bits.Words[i]);
+        }
+    }
+
+    // The GridSize bits of tile row gy
+    template <int GridSize, typename MaskT>
+    inline uint32_t RowBits(const MaskT &mask, int gy)
+    {
+        return static_cast<uint32_t>(mask >> (gy * GridSize)) & ((1u << GridSize) - 1);
+    }
+
+    template <int GridSize>
+    inline uint32_t RowBits(const Mask256 &mask, int gy)
+    {
+        static_assert(GridSize == 16, "Mask256 holds 16x16 tiles");
+        return static_cast<uint32_t>(mask.Words[gy >> 2] >> ((gy & 3) * 16)) & 0xFFFF;
+    }
+
+    // Bit-matrix operations on tile masks. A half-plane mask of one octant of edge normals turns
+    // into the mask of any other octant by a transpose (swap nx and ny) followed by flips (negate
+    // nx or ny), so a table can store a single octant.
+    constexpr uint8_t MaskTranspose = 1;
+    constexpr uint8_t MaskFlipX = 2; // mirror columns, gx -> GridSize - 1 - gx
+    constexpr uint8_t MaskFlipY = 4; // mirror rows, gy -> GridSize - 1 - gy
+
+    // Exchanges the bit groups selected by `select` with the ones `shift` bits above them
+    template <typename T>
+    inline T SwapBits(T m, int shift, T select)
+    {
+        return static_cast<T>(((m >> shift) & select) | ((m & select) << shift));
+    }
+
+    // Exchanges bit i and bit i + shift for every bit i set in `select`
+    template <typename T>
+    inline T DeltaSwap(T m, int shift, T select)
+    {
+        T t = static_cast<T>((m ^ (m >> shift)) & select);
+        return static_cast<T>(m ^ t ^ (t << shift));
+    }
+
+    inline uint16_t FlipX(uint16_t m)
+    {
+        m = SwapBits<uint16_t>(m, 1, 0x5555);
+        return SwapBits<uint16_t>(m, 2, 0x3333);
+    }
+
+    inline uint16_t FlipY(uint16_t m)
+    {
+        m = SwapBits<uint16_t>(m, 4, 0x0F0F);
+        return SwapBits<uint16_t>(m, 8, 0x00FF);
+    }
+
+    inline uint16_t Transpose(uint16_t m)
+    {
+        m = DeltaSwap<uint16_t>(m, 3, 0x0A0A);
+        return DeltaSwap<uint16_t>(m, 6, 0x00CC);
+    }
+
+    inline uint64_t FlipX(uint64_t m)
+    {
+        m = SwapBits<uint64_t>(m, 1, 0x5555555555555555ull);
+        m = SwapBits<uint64_t>(m, 2, 0x3333333333333333ull);
+        return SwapBits<uint64_t>(m, 4, 0x0F0F0F0F0F0F0F0Full);
+    }
+
+    inline uint64_t FlipY(uint64_t m)
+    {
+        m = SwapBits<uint64_t>(m, 8, 0x00FF00FF00FF00FFull);
+        m = SwapBits<uint64_t>(m, 16, 0x0000FFFF0000FFFFull);
+        return (m >> 32) | (m << 32);
+    }
+
+    inline uint64_t Transpose(uint64_t m)
+    {
+        m = DeltaSwap<uint64_t>(m, 7, 0x00AA00AA00AA00AAull);
+        m = DeltaSwap<uint64_t>(m, 14, 0x0000CCCC0000CCCCull);
+        return DeltaSwap<uint64_t>(m, 28, 0x00000000F0F0F0F0ull);
+    }
+
+    inline Mask256 FlipX(const Mask256 &m)
+    {
+        Mask256 r;
+        for(int i = 0; i < 4; ++i)
+        {
+            uint64_t w = m.Words[i];
+            w = SwapBits<uint64_t>(w, 1, 0x5555555555555555ull);
+            w = SwapBits<uint64_t>(w, 2, 0x3333333333333333ull);
+            w = SwapBits<uint64_t>(w, 4, 0x0F0F0F0F0F0F0F0Full);
+            r.Words[i] = SwapBits<uint64_t>(w, 8, 0x00FF00FF00FF00FFull);
+        }
+        return r;
+    }
+
+    inline Mask256 FlipY(const Mask256 &m)
+    {
+        Mask256 r;
+        for(int i = 0; i < 4; ++i)
+        {
+            uint64_t w = SwapBits<uint64_t>(m.Words[i], 16, 0x0000FFFF0000FFFFull);
+            r.Words[3 - i] = (w >> 32) | (w << 32);
+        }
+        return r;
+    }
+
+    // Swaps ever smaller off-diagonal blocks of the 16 rows, blocks of 8, then 4, 2 and 1 columns
+    inline Mask256 Transpose(const Mask256 &m)
+    {
+        uint16_t rows[16];
+        for(int gy = 0; gy < 16; ++gy)
+        {
+            rows[gy] = static_cast<uint16_t>(RowBits<16>(m, gy));
+        }
+        const uint16_t select[4] = { 0x00FF, 0x0F0F, 0x3333, 0x5555 };
+        for(int level = 0, block = 8; block > 0; ++level, block >>= 1)
+        {
+            for(int gy = 0; gy < 16; ++gy)
+            {
+                if(gy & block)
+                {
+                    continue;
+                }
+                uint16_t t = static_cast<uint16_t>(((rows[gy] >> block) ^ rows[gy + block]) & select[level]);
+                rows[gy] ^= static_cast<uint16_t>(t << block);
+                rows[gy + block] ^= t;
+            }
+        }
+        Mask256 r;
+        for(int gy = 0; gy < 16; ++gy)
+        {
+            r.Words[gy >> 2] |= static_cast<uint64_t>(rows[gy]) << ((gy & 3) * 16);
+        }
+        return r;
+    }
+
+    // `a` when `condition` holds, `b` otherwise, without a branch
+    template <typename MaskT>
+    inline MaskT SelectMask(bool condition, const MaskT &a, const MaskT &b)
+    {
+        MaskT select = static_cast<MaskT>(MaskT{} - static_cast<MaskT>(condition));
+        return static_cast<MaskT>(b ^ ((a ^ b) & select));
+    }
+
+    inline Mask256 SelectMask(bool condition, const Mask256 &a, const Mask256 &b)
+    {
+        uint64_t select = 0 - static_cast<uint64_t>(condition);
+        Mask256 r;
+        for(int i = 0; i < 4; ++i)
+        {
+            r.Words[i] = b.Words[i] ^ ((a.Words[i] ^ b.Words[i]) & select);
+        }
+        return r;
+    }
+
+    // Maps a mask of the canonical octant to the octant described by `ops`
+    template <typename MaskT>
+    inline MaskT ApplySymmetry(MaskT m, uint8_t ops)
+    {
+        m = SelectMask(ops & MaskTranspose, Transpose(m), m);
+        m = SelectMask(ops & MaskFlipX, FlipX(m), m);
+        return SelectMask(ops & MaskFlipY, FlipY(m), m);
+    }
+
+    // One tile row of a triangle, offsets are already remapped to offset-index space
+    template <typename MaskT>
+    struct TileRow
+    {
+        using OffsetType = float;
+        const MaskT *Masks[3]; // BitMaskTable + IdxPre of each edge
+        uint8_t Symmetry[3];   // ApplySymmetry ops of each edge, 0 unless the table is symmetric
+        float Offset[3];       // offset index at tile column 0
+        float DeltaX[3];       // offset index step per tile column
+    };
+
+    constexpr int FixedShift = 16; // fractional bits of fixed-point normals and offset indices
+
+    // Fixed-point counterpart of TileRow, used by the deterministic integer setup
+    template <typename MaskT>
+    struct TileRowFixed
+    {
+        using OffsetType = int64_t;
+        const MaskT *Masks[3];
+        uint8_t Symmetry[3];
+        int64_t Offset[3]; // offset index at tile column 0, FixedShift fractional bits
+        int32_t DeltaX[3]; // offset index step per tile column, FixedShift fractional bits
+    };
+
+    // Offset index of tile x0 narrowed to 32 bits for the stepping loops. A batch moves the offset by
+    // at most count * |DeltaX| (well below 2^29 for TileBatch tiles), so a start beyond +-2^30 clamps
+    // to the same table entry for the whole batch and saturating it does not change the result.
+    inline int32_t FixedBatchStart(int64_t offset, int32_t deltaX, int32_t x0)
+    {
+        int64_t start = offset + static_cast<int64_t>(deltaX) * x0;
+        return static_cast<int32_t>(std::clamp<int64_t>(start, -(int64_t(1) << 30), int64_t(1) << 30));
+    }
+
+    // Offset index of a float edge at one tile. It is clamped to the table in float, before the
+    // conversion, because far from the edge of a huge triangle it does not fit an int. The
+    // comparisons are those of maxps/minps, so NaN gives entry 0 in every kernel.
+    template <int32_t OffsetSample>
+    inline int ClampedOffsetIndex(float offset)
+    {
+        offset = offset > 0.0f ? offset : 0.0f;
+        offset = offset < static_cast<float>(OffsetSample - 1) ? offset : static_cast<float>(OffsetSample - 1);
+        return static_cast<int>(offset);
+    }
+
+    // Table mask of edge e. Symmetry is fixed per edge, so the test is perfectly predicted and
+    // the full table pays nothing for it.
+    template <typename TileRowT>
+    inline auto EdgeMask(const TileRowT &row, int e, int offsetIdx)
+    {
+        auto mask = row.Masks[e][offsetIdx];
+        return row.Symmetry[e] ? ApplySymmetry(mask, row.Symmetry[e]) : mask;
+    }
+
+    // Writes the coverage masks of `count` adjacent tiles starting at tile column `x0`
+    template <int32_t OffsetSample, typename MaskT>
+    inline void CoverageRowScalar(const TileRow<MaskT> &row, int32_t x0, int32_t count, MaskT *out)
+    {
+        for(int32_t i = 0; i < count; ++i)
+        {
+            float x = static_cast<float>(x0 + i);
+            MaskT mask = FullMask<MaskT>();
+            for(int e = 0; e < 3; ++e)
+            {
+                mask &= EdgeMask(row, e, ClampedOffsetIndex<OffsetSample>(row.Offset[e] + row.DeltaX[e] * x));
+            }
+            out[i] = mask;
+        }
+    }
+
+    // ApplySymmetry on four/eight 8x8 masks at once, same swaps as the scalar FlipX/FlipY/Transpose.
+    // The callers only get here for edges with ops set, which are fixed for the whole row.
+    RASTERIZER_TARGET("avx2") inline __m256i SwapBitsAVX2(__m256i m, int shift, uint64_t select)
+    {
+        const __m256i s = _mm256_set1_epi64x(static_cast<long long>(select));
+        const __m128i count = _mm_cvtsi32_si128(shift);
+        return _mm256_or_si256(_mm256_and_si256(_mm256_srl_epi64(m, count), s), _mm256_sll_epi64(_mm256_and_si256(m, s), count));
+    }
+
+    RASTERIZER_TARGET("avx2") inline __m256i DeltaSwapAVX2(__m256i m, int shift, uint64_t select)
+    {
+        const __m128i count = _mm_cvtsi32_si128(shift);
+        __m256i t = _mm256_and_si256(_mm256_xor_si256(m, _mm256_srl_epi64(m, count)), _mm256_set1_epi64x(static_cast<long long>(select)));
+        return _mm256_xor_si256(_mm256_xor_si256(m, t), _mm256_sll_epi64(t, count));
+    }
+
+    RASTERIZER_TARGET("avx2") inline __m256i ApplySymmetryAVX2(__m256i m, uint8_t ops)
+    {
+        if(ops & MaskTranspose)
+        {
+            m = DeltaSwapAVX2(m, 7, 0x00AA00AA00AA00AAull);
+            m = DeltaSwapAVX2(m, 14, 0x0000CCCC0000CCCCull);
+            m = DeltaSwapAVX2(m, 28, 0x00000000F0F0F0F0ull);
+        }
+        if(ops & MaskFlipX)
+        {
+            m = SwapBitsAVX2(m, 1, 0x5555555555555555ull);
+            m = SwapBitsAVX2(m, 2, 0x3333333333333333ull);
+            m = SwapBitsAVX2(m, 4, 0x0F0F0F0F0F0F0F0Full);
+        }
+        if(ops & MaskFlipY)
+        {
+            const __m256i reverse = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                                     7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+            m = _mm256_shuffle_epi8(m, reverse);
+        }
+        return m;
+    }
+
+    RASTERIZER_TARGET("avx512f") inline __m512i SwapBitsAVX512(__m512i m, unsigned shift, uint64_t select)
+    {
+        const __m512i s = _mm512_set1_epi64(static_cast<long long>(select));
+        const __m128i count = _mm_cvtsi32_si128(static_cast<int>(shift));
+        return _mm512_or_si512(_mm512_and_si512(_mm512_srl_epi64(m, count), s), _mm512_sll_epi64(_mm512_and_si512(m, s), count));
+    }
+
+    RASTERIZER_TARGET("avx512f") inline __m512i DeltaSwapAVX512(__m512i m, unsigned shift, uint64_t select)
+    {
+        const __m128i count = _mm_cvtsi32_si128(static_cast<int>(shift));
+        __m512i t = _mm512_and_si512(_mm512_xor_si512(m, _mm512_srl_epi64(m, count)), _mm512_set1_epi64(static_cast<long long>(select)));
+        return _mm512_xor_si512(_mm512_xor_si512(m, t), _mm512_sll_epi64(t, count));
+    }
+
+    RASTERIZER_TARGET("avx512f") inline __m512i ApplySymmetryAVX512(__m512i m, uint8_t ops)
+    {
+        if(ops & MaskTranspose)
+        {
+            m = DeltaSwapAVX512(m, 7, 0x00AA00AA00AA00AAull);
+            m = DeltaSwapAVX512(m, 14, 0x0000CCCC0000CCCCull);
+            m = DeltaSwapAVX512(m, 28, 0x00000000F0F0F0F0ull);
+        }
+        if(ops & MaskFlipX)
+        {
+            m = SwapBitsAVX512(m, 1, 0x5555555555555555ull);
+            m = SwapBitsAVX512(m, 2, 0x3333333333333333ull);
+            m = SwapBitsAVX512(m, 4, 0x0F0F0F0F0F0F0F0Full);
+        }
+        if(ops & MaskFlipY)
+        {
+            m = SwapBitsAVX512(m, 8, 0x00FF00FF00FF00FFull);
+            m = SwapBitsAVX512(m, 16, 0x0000FFFF0000FFFFull);
+            m = _mm512_ror_epi64(m, 32);
+        }
+        return m;
+    }
+
+    // Eight tiles per iteration, the offset indices of all three edges are computed in one
+    // register each and the masks are fetched with two 4-wide 64-bit gathers per edge.
+    // Same float operations as the scalar path, so the result is bit-identical. 8x8 tiles only.
+    template <int32_t OffsetSample>
+    RASTERIZER_TARGET("avx2") inline void CoverageRowAVX2(const TileRow<uint64_t> &row, int32_t x0, int32_t count, uint64_t *out)
+    {
+        const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256 minIdx = _mm256_setzero_ps();
+        const __m256 maxIdx = _mm256_set1_ps(static_cast<float>(OffsetSample - 1));
+        const __m256 offset[3] = { _mm256_set1_ps(row.Offset[0]), _mm256_set1_ps(row.Offset[1]), _mm256_set1_ps(row.Offset[2]) };
+        const __m256 deltax[3] = { _mm256_set1_ps(row.DeltaX[0]), _mm256_set1_ps(row.DeltaX[1]), _mm256_set1_ps(row.DeltaX[2]) };
+
+        int32_t i = 0;
+        for(; i + 8 <= count; i += 8)
+        {
+            __m256 x = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x0 + i), lane));
+            __m256i lo = _mm256_set1_epi64x(-1);
+            __m256i hi = lo;
+            for(int e = 0; e < 3; ++e)
+            {
+                __m256 unclamped = _mm256_add_ps(offset[e], _mm256_mul_ps(deltax[e], x));
+                __m256i offsetIdx = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(unclamped, minIdx), maxIdx));
+                const long long *table = reinterpret_cast<const long long *>(row.Masks[e]);
+                __m256i masksLo = _mm256_i32gather_epi64(table, _mm256_castsi256_si128(offsetIdx), 8);
+                __m256i masksHi = _mm256_i32gather_epi64(table, _mm256_extracti128_si256(offsetIdx, 1), 8);
+                if(row.Symmetry[e])
+                {
+                    masksLo = ApplySymmetryAVX2(masksLo, row.Symmetry[e]);
+                    masksHi = ApplySymmetryAVX2(masksHi, row.Symmetry[e]);
+                }
+                lo = _mm256_and_si256(lo, masksLo);
+                hi = _mm256_and_si256(hi, masksHi);
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), lo);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i + 4), hi);
+        }
+        CoverageRowScalar<OffsetSample>(row, x0 + i, count - i, out + i);
+    }
+
+    // Four tiles per iteration, SSE has no gather so the masks are loaded one by one. That works
+    // for any mask type, so this is also the vector kernel of the 4x4 and 16x16 grids.
+    template <int32_t OffsetSample, typename MaskT>
+    RASTERIZER_TARGET("sse4.2") inline void CoverageRowSSE42(const TileRow<MaskT> &row, int32_t x0, int32_t count, MaskT *out)
+    {
+        const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+        const __m128 minIdx = _mm_setzero_ps();
+        const __m128 maxIdx = _mm_set1_ps(static_cast<float>(OffsetSample - 1));
+        const __m128 offset[3] = { _mm_set1_ps(row.Offset[0]), _mm_set1_ps(row.Offset[1]), _mm_set1_ps(row.Offset[2]) };
+        const __m128 deltax[3] = { _mm_set1_ps(row.DeltaX[0]), _mm_set1_ps(row.DeltaX[1]), _mm_set1_ps(row.DeltaX[2]) };
+
+        int32_t i = 0;
+        for(; i + 4 <= count; i += 4)
+        {
+            __m128 x = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x0 + i), lane));
+            alignas(16) int32_t offsetIdx[3][4];
+            for(int e = 0; e < 3; ++e)
+            {
+                __m128 unclamped = _mm_add_ps(offset[e], _mm_mul_ps(deltax[e], x));
+                __m128i idx = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(unclamped, minIdx), maxIdx));
+                _mm_store_si128(reinterpret_cast<__m128i *>(offsetIdx[e]), idx);
+            }
+            for(int k = 0; k < 4; ++k)
+            {
+                out[i + k] = EdgeMask(row, 0, offsetIdx[0][k]) & EdgeMask(row, 1, offsetIdx[1][k]) & EdgeMask(row, 2, offsetIdx[2][k]);
+            }
+        }
+        CoverageRowScalar<OffsetSample>(row, x0 + i, count - i, out + i);
+    }
+
+    // Sixteen tiles per iteration with two 8-wide 64-bit gathers per edge
+    RASTERIZER_AVX512_WARNINGS_PUSH
+    template <int32_t OffsetSample>
+    RASTERIZER_TARGET("avx512f") inline void CoverageRowAVX512(const TileRow<uint64_t> &row, int32_t x0, int32_t count, uint64_t *out)
+    {
+        const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        const __m512 minIdx = _mm512_setzero_ps();
+        const __m512 maxIdx = _mm512_set1_ps(static_cast<float>(OffsetSample - 1));
+        const __m512 offset[3] = { _mm512_set1_ps(row.Offset[0]), _mm512_set1_ps(row.Offset[1]), _mm512_set1_ps(row.Offset[2]) };
+        const __m512 deltax[3] = { _mm512_set1_ps(row.DeltaX[0]), _mm512_set1_ps(row.DeltaX[1]), _mm512_set1_ps(row.DeltaX[2]) };
+
+        int32_t i = 0;
+        for(; i + 16 <= count; i += 16)
+        {
+            __m512 x = _mm512_cvtepi32_ps(_mm512_add_epi32(_mm512_set1_epi32(x0 + i), lane));
+            __m512i lo = _mm512_set1_epi64(-1);
+            __m512i hi = lo;
+            for(int e = 0; e < 3; ++e)
+            {
+                __m512 unclamped = _mm512_add_ps(offset[e], _mm512_mul_ps(deltax[e], x));
+                __m512i offsetIdx = _mm512_cvttps_epi32(_mm512_min_ps(_mm512_max_ps(unclamped, minIdx), maxIdx));
+                __m512i masksLo = _mm512_i32gather_epi64(_mm512_castsi512_si256(offsetIdx), row.Masks[e], 8);
+                __m512i masksHi = _mm512_i32gather_epi64(_mm512_extracti64x4_epi64(offsetIdx, 1), row.Masks[e], 8);
+                if(row.Symmetry[e])
+                {
+                    masksLo = ApplySymmetryAVX512(masksLo, row.Symmetry[e]);
+                    masksHi = ApplySymmetryAVX512(masksHi, row.Symmetry[e]);
+                }
+                lo = _mm512_and_si512(lo, masksLo);
+                hi = _mm512_and_si512(hi, masksHi);
+            }
+            _mm512_storeu_si512(out + i, lo);
+            _mm512_storeu_si512(out + i + 8, hi);
+        }
+        CoverageRowAVX2<OffsetSample>(row, x0 + i, count - i, out + i);
+    }
+    RASTERIZER_AVX512_WARNINGS_POP
+
+    // Integer kernels: the offset index of each edge is stepped with one add per tile and
+    // turned into a table index with a shift, no float operations at all
+    template <int32_t OffsetSample, typename MaskT>
+    inline void CoverageRowFixedScalar(const TileRowFixed<MaskT> &row, int32_t x0, int32_t count, MaskT *out)
+    {
+        int32_t offset[3];
+        for(int e = 0; e < 3; ++e)
+        {
+            offset[e] = FixedBatchStart(row.Offset[e], row.DeltaX[e], x0);
+        }
+        for(int32_t i = 0; i < count; ++i)
+        {
+            MaskT mask = FullMask<MaskT>();
+            for(int e = 0; e < 3; ++e)
+            {
+                int offsetIdx = std::clamp(offset[e] >> FixedShift, 0, OffsetSample - 1);
+                mask &= EdgeMask(row, e, offsetIdx);
+                offset[e] += row.DeltaX[e];
+            }
+            out[i] = mask;
+        }
+    }
+
+    template <int32_t OffsetSample, typename MaskT>
+    RASTERIZER_TARGET("sse4.2") inline void CoverageRowFixedSSE42(const TileRowFixed<MaskT> &row, int32_t x0, int32_t count, MaskT *out)
+    {
+        const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+        const __m128i minIdx = _mm_setzero_si128();
+        const __m128i maxIdx = _mm_set1_epi32(OffsetSample - 1);
+        __m128i offset[3], step[3];
+        for(int e = 0; e < 3; ++e)
+        {
+            __m128i deltax = _mm_set1_epi32(row.DeltaX[e]);
+            offset[e] = _mm_add_epi32(_mm_set1_epi32(FixedBatchStart(row.Offset[e], row.DeltaX[e], x0)), _mm_mullo_epi32(deltax, lane));
+            step[e] = _mm_slli_epi32(deltax, 2);
+        }
+
+        int32_t i = 0;
+        for(; i + 4 <= count; i += 4)
+        {
+            alignas(16) int32_t offsetIdx[3][4];
+            for(int e = 0; e < 3; ++e)
+            {
+                __m128i idx = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(offset[e], FixedShift), minIdx), maxIdx);
+                _mm_store_si128(reinterpret_cast<__m128i *>(offsetIdx[e]), idx);
+                offset[e] = _mm_add_epi32(offset[e], step[e]);
+            }
+            for(int k = 0; k < 4; ++k)
+            {
+                out[i + k] = EdgeMask(row, 0, offsetIdx[0][k]) & EdgeMask(row, 1, offsetIdx[1][k]) & EdgeMask(row, 2, offsetIdx[2][k]);
+            }
+        }
+        CoverageRowFixedScalar<OffsetSample>(row, x0 + i, count - i, out + i);
+    }
+
+    template <int32_t OffsetSample>
+    RASTERIZER_TARGET("avx2") inline void CoverageRowFixedAVX2(const TileRowFixed<uint64_t> &row, int32_t x0, int32_t count, uint64_t *out)
+    {
+        const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i minIdx = _mm256_setzero_si256();
+        const __m256i maxIdx = _mm256_set1_epi32(OffsetSample - 1);
+        __m256i offset[3], step[3];
+        for(int e = 0; e < 3; ++e)
+        {
+            __m256i deltax = _mm256_set1_epi32(row.DeltaX[e]);
+            offset[e] = _mm256_add_epi32(_mm256_set1_epi32(FixedBatchStart(row.Offset[e], row.DeltaX[e], x0)), _mm256_mullo_epi32(deltax, lane));
+            step[e] = _mm256_slli_epi32(deltax, 3);
+        }
+
+        int32_t i = 0;
+        for(; i + 8 <= count; i += 8)
+        {
+            __m256i lo = _mm256_set1_epi64x(-1);
+            __m256i hi = lo;
+            for(int e = 0; e < 3; ++e)
+            {
+                __m256i offsetIdx = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(offset[e], FixedShift), minIdx), maxIdx);
+                const long long *table = reinterpret_cast<const long long *>(row.Masks[e]);
+                __m256i masksLo = _mm256_i32gather_epi64(table, _mm256_castsi256_si128(offsetIdx), 8);
+                __m256i masksHi = _mm256_i32gather_epi64(table, _mm256_extracti128_si256(offsetIdx, 1), 8);
+                if(row.Symmetry[e])
+                {
+                    masksLo = ApplySymmetryAVX2(masksLo, row.Symmetry[e]);
+                    masksHi = ApplySymmetryAVX2(masksHi, row.Symmetry[e]);
+                }
+                lo = _mm256_and_si256(lo, masksLo);
+                hi = _mm256_and_si256(hi, masksHi);
+                offset[e] = _mm256_add_epi32(offset[e], step[e]);
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), lo);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i + 4), hi);
+        }
+        CoverageRowFixedScalar<OffsetSample>(row, x0 + i, count - i, out + i);
+    }
+
+    RASTERIZER_AVX512_WARNINGS_PUSH
+    template <int32_t OffsetSample>
+    RASTERIZER_TARGET("avx512f") inline void CoverageRowFixedAVX512(const TileRowFixed<uint64_t> &row, int32_t x0, int32_t count, uint64_t *out)
+    {
+        const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        const __m512i minIdx = _mm512_setzero_si512();
+        const __m512i maxIdx = _mm512_set1_epi32(OffsetSample - 1);
+        __m512i offset[3], step[3];
+        for(int e = 0; e < 3; ++e)
+        {
+            __m512i deltax = _mm512_set1_epi32(row.DeltaX[e]);
+            offset[e] = _mm512_add_epi32(_mm512_set1_epi32(FixedBatchStart(row.Offset[e], row.DeltaX[e], x0)), _mm512_mullo_epi32(deltax, lane));
+            step[e] = _mm512_slli_epi32(deltax, 4);
+        }
+
+        int32_t i = 0;
+        for(; i + 16 <= count; i += 16)
+        {
+            __m512i lo = _mm512_set1_epi64(-1);
+            __m512i hi = lo;
+            for(int e = 0; e < 3; ++e)
+            {
+                __m512i offsetIdx = _mm512_min_epi32(_mm512_max_epi32(_mm512_srai_epi32(offset[e], FixedShift), minIdx), maxIdx);
+                __m512i masksLo = _mm512_i32gather_epi64(_mm512_castsi512_si256(offsetIdx), row.Masks[e], 8);
+                __m512i masksHi = _mm512_i32gather_epi64(_mm512_extracti64x4_epi64(offsetIdx, 1), row.Masks[e], 8);
+                if(row.Symmetry[e])
+                {
+                    masksLo = ApplySymmetryAVX512(masksLo, row.Symmetry[e]);
+                    masksHi = ApplySymmetryAVX512(masksHi, row.Symmetry[e]);
+                }
+                lo = _mm512_and_si512(lo, masksLo);
+                hi = _mm512_and_si512(hi, masksHi);
+                offset[e] = _mm512_add_epi32(offset[e], step[e]);
+            }
+            _mm512_storeu_si512(out + i, lo);
+            _mm512_storeu_si512(out + i + 8, hi);
+        }
+        CoverageRowFixedAVX2<OffsetSample>(row, x0 + i, count - i, out + i);
+    }
+    RASTERIZER_AVX512_WARNINGS_POP
+
+    // Tile writers set the covered pixels of an 8x8 tile that lies completely inside the
+    // framebuffer, bit gy * 8 + gx of the mask is pixel (gx, gy) of the tile. Each row of
+    // the mask is expanded to 8 bytes of 0x00/0xFF and ORed into the framebuffer with one
+    // 8-byte load/store, so the cost does not depend on how many pixels are covered.
+    inline void OrTileRows(uint8_t *dst, int32_t stride, const uint64_t rows[8])
+    {
+        for(int gy = 0; gy < 8; ++gy)
+        {
+            uint64_t pixels;
+            std::memcpy(&pixels, dst + gy * stride, sizeof(pixels));
+            pixels |= rows[gy];
+            std::memcpy(dst + gy * stride, &pixels, sizeof(pixels));
+        }
+    }
+
+    inline void FillTile(uint8_t *dst, int32_t stride)
+    {
+        const uint64_t full = ~0ull;
+        for(int gy = 0; gy < 8; ++gy)
+        {
+            std::memcpy(dst + gy * stride, &full, sizeof(full));
+        }
+    }
+
+    // 8 bits to 8 bytes: spread bit i into byte i, then smear each non-zero byte to 0xFF
+    inline uint64_t ExpandRowScalar(uint64_t bits)
+    {
+        uint64_t spread = (bits * 0x0101010101010101ull) & 0x8040201008040201ull;
+        uint64_t high = ((spread + 0x7F7F7F7F7F7F7F7Full) | spread) & 0x8080808080808080ull;
+        return (high >> 7) * 0xFF;
+    }
+
+    inline void WriteTileScalar(uint8_t *dst, int32_t stride, uint64_t mask)
+    {
+        if(mask == 0)
+        {
+            return;
+        }
+        if(mask == ~0ull)
+        {
+            FillTile(dst, stride);
+            return;
+        }
+        uint64_t rows[8];
+        for(int gy = 0; gy < 8; ++gy)
+        {
+            rows[gy] = ExpandRowScalar((mask >> (gy * 8)) & 0xFF);
+        }
+        OrTileRows(dst, stride, rows);
+    }
+
+    // Two rows per register: broadcast the row byte to 8 lanes, then test one bit per lane
+    RASTERIZER_TARGET("sse4.2") inline void WriteTileSSE42(uint8_t *dst, int32_t stride, uint64_t mask)
+    {
+        if(mask == 0)
+        {
+            return;
+        }
+        if(mask == ~0ull)
+        {
+            FillTile(dst, stride);
+            return;
+        }
+        const __m128i bits = _mm_set1_epi64x(0x8040201008040201ll);
+        const __m128i select = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+        const __m128i m = _mm_cvtsi64_si128(static_cast<long long>(mask));
+        alignas(16) uint64_t rows[8];
+        for(int gy = 0; gy < 8; gy += 2)
+        {
+            __m128i v = _mm_shuffle_epi8(m, _mm_add_epi8(select, _mm_set1_epi8(static_cast<char>(gy))));
+            v = _mm_cmpeq_epi8(_mm_and_si128(v, bits), bits);
+            _mm_store_si128(reinterpret_cast<__m128i *>(rows + gy), v);
+        }
+        OrTileRows(dst, stride, rows);
+    }
+
+    // Four rows per register, the byte shuffle works per 128-bit lane on the broadcast mask
+    RASTERIZER_TARGET("avx2") inline void WriteTileAVX2(uint8_t *dst, int32_t stride, uint64_t mask)
+    {
+        if(mask == 0)
+        {
+            return;
+        }
+        if(mask == ~0ull)
+        {
+            FillTile(dst, stride);
+            return;
+        }
+        const __m256i bits = _mm256_set1_epi64x(0x8040201008040201ll);
+        const __m256i select = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                                2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+        const __m256i m = _mm256_set1_epi64x(static_cast<long long>(mask));
+        __m256i lo = _mm256_shuffle_epi8(m, select);
+        __m256i hi = _mm256_shuffle_epi8(m, _mm256_add_epi8(select, _mm256_set1_epi8(4)));
+        alignas(32) uint64_t rows[8];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(rows), _mm256_cmpeq_epi8(_mm256_and_si256(lo, bits), bits));
+        _mm256_store_si256(reinterpret_cast<__m256i *>(rows + 4), _mm256_cmpeq_epi8(_mm256_and_si256(hi, bits), bits));
+        OrTileRows(dst, stride, rows);
+    }
+
+    // The whole tile in one instruction, byte i of vpmovm2b is bit i of the mask
+    RASTERIZER_TARGET("avx512f,avx512bw") inline void WriteTileAVX512(uint8_t *dst, int32_t stride, uint64_t mask)
+    {
+        if(mask == 0)
+        {
+            return;
+        }
+        if(mask == ~0ull)
+        {
+            FillTile(dst, stride);
+            return;
+        }
+        alignas(64) uint64_t rows[8];
+        _mm512_store_si512(rows, _mm512_movm_epi8(mask));
+        OrTileRows(dst, stride, rows);
+    }
+
+    // Any grid size: each row of the mask is expanded 8 pixels at a time with ExpandRowScalar
+    template <int GridSize, typename MaskT>
+    inline void WriteTileRows(uint8_t *dst, int32_t stride, MaskT mask)
+    {
+        if(mask == MaskT{})
+        {
+            return;
+        }
+        for(int gy = 0; gy < GridSize; ++gy)
+        {
+            uint32_t bits = RowBits<GridSize>(mask, gy);
+            for(int gx = 0; gx < GridSize; gx += 8)
+            {
+                uint64_t pixels;
+                int columns = std::min(GridSize - gx, 8);
+                std::memcpy(&pixels, dst + gy * stride + gx, columns);
+                pixels |= ExpandRowScalar((bits >> gx) & 0xFF);
+                std::memcpy(dst + gy * stride + gx, &pixels, columns);
+            }
+        }
+    }
+
+    // Batched float triangle setup in structure-of-arrays form, SetupLanes triangles at a time.
+    // Square roots and divides are the IEEE ones a per-triangle glm setup uses (no reciprocal
+    // estimates, no FMA), so every lane is bit-identical to the scalar result. Vertices come in
+    // pixels, the callers do the viewport transform (or get it from TransformVertices).
+    constexpr int SetupLanes = 8;
+
+    struct TriangleBatch
+    {
+        // In: vertices in pixels
+        alignas(32) float X[3][SetupLanes];
+        alignas(32) float Y[3][SetupLanes];
+        // Out: edge e runs from vertex e to vertex e + 1, LineX * x + LineY * y + LineZ in pixels
+        alignas(32) float LineX[3][SetupLanes];
+        alignas(32) float LineY[3][SetupLanes];
+        alignas(32) float LineZ[3][SetupLanes];
+        // Out: pixel bounding box clamped to [0, width] x [0, height], floor of the minimum and ceil of the maximum
+        alignas(32) int32_t MinX[SetupLanes];
+        alignas(32) int32_t MaxX[SetupLanes];
+        alignas(32) int32_t MinY[SetupLanes];
+        alignas(32) int32_t MaxY[SetupLanes];
+        // Out: edge direction bucket of BasicRasterizer::OctantAngle, Step is not clamped
+        alignas(32) int32_t Octant[3][SetupLanes];
+        alignas(32) int32_t Step[3][SetupLanes];
+    };
+
+    // Same result as _mm_min_ps(_mm_max_ps(value, 0), size), NaN goes to 0
+    inline float ClampToScreen(float value, float size)
+    {
+        value = value > 0 ? value : 0.0f;
+        return value < size ? value : size;
+    }
+
+    // The first `count` lanes, the SIMD kernels always do all of them
+    inline void SetupTrianglesScalar(TriangleBatch &batch, int32_t count, float width, float height, float quantization)
+    {
+        for(int i = 0; i < count; ++i)
+        {
+            const float x[3] = { batch.X[0][i], batch.X[1][i], batch.X[2][i] };
+            const float y[3] = { batch.Y[0][i], batch.Y[1][i], batch.Y[2][i] };
+            batch.MinX[i] = (int)std::floor(ClampToScreen(std::min({ x[0], x[1], x[2] }), width));
+            batch.MaxX[i] = (int)std::ceil(ClampToScreen(std::max({ x[0], x[1], x[2] }), width));
+            batch.MinY[i] = (int)std::floor(ClampToScreen(std::min({ y[0], y[1], y[2] }), height));
+            batch.MaxY[i] = (int)std::ceil(ClampToScreen(std::max({ y[0], y[1], y[2] }), height));
+            for(int e = 0; e < 3; ++e)
+            {
+                int a = e;
+                int b = (e + 1) % 3;
+                float ex = x[a] - x[b];
+                float ey = y[a] - y[b];
+                float c = x[a] * y[b] - y[a] * x[b];
+                float length = std::sqrt(ex * ex + ey * ey);
+                float inverse = 1.0f / length;
+                float nx = ey * inverse;
+                float ny = -ex * inverse;
+                batch.LineX[e][i] = nx;
+                batch.LineY[e][i] = ny;
+                batch.LineZ[e][i] = c / length;
+
+                float ax = std::abs(nx);
+                float ay = std::abs(ny);
+                bool steep = ay > ax;
+                float ratio = steep ? ax / ay : (ax > 0 ? ay / ax : 0.0f); // degenerate normals land on step 0
+                batch.Octant[e][i] = (ny < 0) << 2 | (nx < 0) << 1 | steep;
+                batch.Step[e][i] = static_cast<int32_t>(ratio * quantization);
+            }
+        }
+    }
+
+    RASTERIZER_TARGET("sse4.2")
+    inline void SetupTrianglesSSE42(TriangleBatch &batch, int32_t count, float width, float height, float quantization)
+    {
+        (void)count;
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        for(int i = 0; i < SetupLanes; i += 4)
+        {
+            __m128 x[3], y[3];
+            for(int k = 0; k < 3; ++k)
+            {
+                x[k] = _mm_load_ps(&batch.X[k][i]);
+                y[k] = _mm_load_ps(&batch.Y[k][i]);
+            }
+            __m128 width4 = _mm_set1_ps(width);
+            __m128 height4 = _mm_set1_ps(height);
+            __m128 minX = _mm_min_ps(_mm_max_ps(_mm_min_ps(_mm_min_ps(x[0], x[1]), x[2]), zero), width4);
+            __m128 maxX = _mm_min_ps(_mm_max_ps(_mm_max_ps(_mm_max_ps(x[0], x[1]), x[2]), zero), width4);
+            __m128 minY = _mm_min_ps(_mm_max_ps(_mm_min_ps(_mm_min_ps(y[0], y[1]), y[2]), zero), height4);
+            __m128 maxY = _mm_min_ps(_mm_max_ps(_mm_max_ps(_mm_max_ps(y[0], y[1]), y[2]), zero), height4);
+            _mm_store_si128(reinterpret_cast<__m128i *>(&batch.MinX[i]), _mm_cvttps_epi32(_mm_floor_ps(minX)));
+            _mm_store_si128(reinterpret_cast<__m128i *>(&batch.MaxX[i]), _mm_cvttps_epi32(_mm_ceil_ps(maxX)));
+            _mm_store_si128(reinterpret_cast<__m128i *>(&batch.MinY[i]), _mm_cvttps_epi32(_mm_floor_ps(minY)));
+            _mm_store_si128(reinterpret_cast<__m128i *>(&batch.MaxY[i]), _mm_cvttps_epi32(_mm_ceil_ps(maxY)));
+            for(int e = 0; e < 3; ++e)
+            {
+                int a = e;
+                int b = (e + 1) % 3;
+                __m128 ex = _mm_sub_ps(x[a], x[b]);
+                __m128 ey = _mm_sub_ps(y[a], y[b]);
+                __m128 c = _mm_sub_ps(_mm_mul_ps(x[a], y[b]), _mm_mul_ps(y[a], x[b]));
+                __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)));
+                __m128 inverse = _mm_div_ps(one, length);
+                __m128 nx = _mm_mul_ps(ey, inverse);
+                __m128 ny = _mm_mul_ps(_mm_xor_ps(ex, sign), inverse);
+                _mm_store_ps(&batch.LineX[e][i], nx);
+                _mm_store_ps(&batch.LineY[e][i], ny);
+                _mm_store_ps(&batch.LineZ[e][i], _mm_div_ps(c, length));
+
+                __m128 ax = _mm_andnot_ps(sign, nx);
+                __m128 ay = _mm_andnot_ps(sign, ny);
+                __m128 steep = _mm_cmpgt_ps(ay, ax);
+                __m128 flat = _mm_and_ps(_mm_div_ps(ay, ax), _mm_cmpgt_ps(ax, zero));
+                __m128 ratio = _mm_blendv_ps(flat, _mm_div_ps(ax, ay), steep);
+                __m128i octant = _mm_or_si128(_mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(ny, zero)), _mm_set1_epi32(4)),
+                                 _mm_or_si128(_mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(nx, zero)), _mm_set1_epi32(2)),
+                                              _mm_and_si128(_mm_castps_si128(steep), _mm_set1_epi32(1))));
+                _mm_store_si128(reinterpret_cast<__m128i *>(&batch.Octant[e][i]), octant);
+                _mm_store_si128(reinterpret_cast<__m128i *>(&batch.Step[e][i]), _mm_cvttps_epi32(_mm_mul_ps(ratio, _mm_set1_ps(quantization))));
+            }
+        }
+    }
+
+    RASTERIZER_TARGET("avx2")
+    inline void SetupTrianglesAVX2(TriangleBatch &batch, int32_t count, float width, float height, float quantization)
+    {
+        (void)count;
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        __m256 x[3], y[3];
+        for(int k = 0; k < 3; ++k)
+        {
+            x[k] = _mm256_load_ps(batch.X[k]);
+            y[k] = _mm256_load_ps(batch.Y[k]);
+        }
+        __m256 width8 = _mm256_set1_ps(width);
+        __m256 height8 = _mm256_set1_ps(height);
+        __m256 minX = _mm256_min_ps(_mm256_max_ps(_mm256_min_ps(_mm256_min_ps(x[0], x[1]), x[2]), zero), width8);
+        __m256 maxX = _mm256_min_ps(_mm256_max_ps(_mm256_max_ps(_mm256_max_ps(x[0], x[1]), x[2]), zero), width8);
+        __m256 minY = _mm256_min_ps(_mm256_max_ps(_mm256_min_ps(_mm256_min_ps(y[0], y[1]), y[2]), zero), height8);
+        __m256 maxY = _mm256_min_ps(_mm256_max_ps(_mm256_max_ps(_mm256_max_ps(y[0], y[1]), y[2]), zero), height8);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(batch.MinX), _mm256_cvttps_epi32(_mm256_floor_ps(minX)));
+        _mm256_store_si256(reinterpret_cast<__m256i *>(batch.MaxX), _mm256_cvttps_epi32(_mm256_ceil_ps(maxX)));
+        _mm256_store_si256(reinterpret_cast<__m256i *>(batch.MinY), _mm256_cvttps_epi32(_mm256_floor_ps(minY)));
+        _mm256_store_si256(reinterpret_cast<__m256i *>(batch.MaxY), _mm256_cvttps_epi32(_mm256_ceil_ps(maxY)));
+        for(int e = 0; e < 3; ++e)
+        {
+            int a = e;
+            int b = (e + 1) % 3;
+            __m256 ex = _mm256_sub_ps(x[a], x[b]);
+            __m256 ey = _mm256_sub_ps(y[a], y[b]);
+            __m256 c = _mm256_sub_ps(_mm256_mul_ps(x[a], y[b]), _mm256_mul_ps(y[a], x[b]));
+            __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey)));
+            __m256 inverse = _mm256_div_ps(one, length);
+            __m256 nx = _mm256_mul_ps(ey, inverse);
+            __m256 ny = _mm256_mul_ps(_mm256_xor_ps(ex, sign), inverse);
+            _mm256_store_ps(batch.LineX[e], nx);
+            _mm256_store_ps(batch.LineY[e], ny);
+            _mm256_store_ps(batch.LineZ[e], _mm256_div_ps(c, length));
+
+            __m256 ax = _mm256_andnot_ps(sign, nx);
+            __m256 ay = _mm256_andnot_ps(sign, ny);
+            __m256 steep = _mm256_cmp_ps(ay, ax, _CMP_GT_OQ);
+            __m256 flat = _mm256_and_ps(_mm256_div_ps(ay, ax), _mm256_cmp_ps(ax, zero, _CMP_GT_OQ));
+            __m256 ratio = _mm256_blendv_ps(flat, _mm256_div_ps(ax, ay), steep);
+            __m256i octant = _mm256_or_si256(_mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(ny, zero, _CMP_LT_OQ)), _mm256_set1_epi32(4)),
+                             _mm256_or_si256(_mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(nx, zero, _CMP_LT_OQ)), _mm256_set1_epi32(2)),
+                                             _mm256_and_si256(_mm256_castps_si256(steep), _mm256_set1_epi32(1))));
+            _mm256_store_si256(reinterpret_cast<__m256i *>(batch.Octant[e]), octant);
+            _mm256_store_si256(reinterpret_cast<__m256i *>(batch.Step[e]), _mm256_cvttps_epi32(_mm256_mul_ps(ratio, _mm256_set1_ps(quantization))));
+        }
+    }
+
+    // Triangle classification of the culling stage, CullLanes triangles at a time, bit i of each
+    // mask is triangle i. ClassifyTriangles reads vertices as they are submitted, NDC x, y, z per
+    // vertex and 3 vertices per triangle, and maps them to pixels with the expression of the
+    // setup. ClassifyScreenTriangles reads the pixel streams of TransformVertices, vertex k of
+    // triangle i at 3 * i + k.
+    constexpr int CullLanes = 8;
+
+    struct CullMasks
+    {
+        uint32_t Front;     // positive area, counter-clockwise with y up, the winding the edge functions cover
+        uint32_t Back;      // negative area; zero or NaN area sets neither bit
+        uint32_t OffScreen; // Front or Back, and the bounds grown by a pixel on every side miss the screen
+    };
+
+    inline uint32_t PopCount(uint32_t bits)
+    {
+        bits = bits - ((bits >> 1) & 0x55555555u);
+        bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+        return (((bits + (bits >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+    }
+
+    // bits must not be 0
+    inline int CountTrailingZeros(uint32_t bits)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, bits);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(bits);
+#endif
+    }
+
+    // Sets bit `lane` of masks for one triangle in pixels
+    inline void ClassifyLane(const float x[3], const float y[3], float width, float height, int lane, CullMasks &masks)
+    {
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        bool onScreen = std::max({ x[0], x[1], x[2] }) + 1.0f > 0 && std::max({ y[0], y[1], y[2] }) + 1.0f > 0 &&
+                        std::min({ x[0], x[1], x[2] }) - 1.0f < width && std::min({ y[0], y[1], y[2] }) - 1.0f < height;
+        masks.Front |= static_cast<uint32_t>(area > 0) << lane;
+        masks.Back |= static_cast<uint32_t>(area < 0) << lane;
+        masks.OffScreen |= static_cast<uint32_t>(!onScreen && (area > 0 || area < 0)) << lane;
+    }
+
+    inline CullMasks ClassifyTrianglesScalar(const float *vertices, int32_t count, float width, float height)
+    {
+        CullMasks masks = {};
+        for(int i = 0; i < count; ++i)
+        {
+            const float *v = vertices + i * 9;
+            float x[3], y[3];
+            for(int k = 0; k < 3; ++k)
+            {
+                x[k] = (v[k * 3] + 1.0f) * 0.5f * width;
+                y[k] = (v[k * 3 + 1] + 1.0f) * 0.5f * height;
+            }
+            ClassifyLane(x, y, width, height, i, masks);
+        }
+        return masks;
+    }
+
+    inline CullMasks ClassifyScreenTrianglesScalar(const float *screenX, const float *screenY, int32_t count, float width, float height)
+    {
+        CullMasks masks = {};
+        for(int i = 0; i < count; ++i)
+        {
+            ClassifyLane(screenX + i * 3, screenY + i * 3, width, height, i, masks);
+        }
+        return masks;
+    }
+
+    // Lanes in `valid` go to bits [shift, shift + 4) of masks
+    RASTERIZER_TARGET("sse4.2")
+    inline void ClassifyLanesSSE42(const __m128 x[3], const __m128 y[3], float width, float height, uint32_t valid, int shift, CullMasks &masks)
+    {
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 zero = _mm_setzero_ps();
+        __m128 area = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(x[1], x[0]), _mm_sub_ps(y[2], y[0])), _mm_mul_ps(_mm_sub_ps(x[2], x[0]), _mm_sub_ps(y[1], y[0])));
+        __m128 onScreen = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(_mm_add_ps(_mm_max_ps(_mm_max_ps(x[0], x[1]), x[2]), one), zero),
+                                                _mm_cmpgt_ps(_mm_add_ps(_mm_max_ps(_mm_max_ps(y[0], y[1]), y[2]), one), zero)),
+                                     _mm_and_ps(_mm_cmplt_ps(_mm_sub_ps(_mm_min_ps(_mm_min_ps(x[0], x[1]), x[2]), one), _mm_set1_ps(width)),
+                                                _mm_cmplt_ps(_mm_sub_ps(_mm_min_ps(_mm_min_ps(y[0], y[1]), y[2]), one), _mm_set1_ps(height))));
+        uint32_t front = _mm_movemask_ps(_mm_cmpgt_ps(area, zero)) & valid;
+        uint32_t back = _mm_movemask_ps(_mm_cmplt_ps(area, zero)) & valid;
+        masks.Front |= front << shift;
+        masks.Back |= back << shift;
+        masks.OffScreen |= (~_mm_movemask_ps(onScreen) & (front | back)) << shift;
+    }
+
+    RASTERIZER_TARGET("sse4.2")
+    inline CullMasks ClassifyTrianglesSSE42(const float *vertices, int32_t count, float width, float height)
+    {
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 half = _mm_set1_ps(0.5f);
+        CullMasks masks = {};
+        for(int i = 0; i < count; i += 4)
+        {
+            // Lanes past count repeat the last triangle and are masked off
+            const float *v[4];
+            for(int lane = 0; lane < 4; ++lane)
+            {
+                v[lane] = vertices + std::min(i + lane, count - 1) * 9;
+            }
+            __m128 x[3], y[3];
+            for(int k = 0; k < 3; ++k)
+            {
+                x[k] = _mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_setr_ps(v[0][k * 3], v[1][k * 3], v[2][k * 3], v[3][k * 3]), one), half), _mm_set1_ps(width));
+                y[k] = _mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_setr_ps(v[0][k * 3 + 1], v[1][k * 3 + 1], v[2][k * 3 + 1], v[3][k * 3 + 1]), one), half), _mm_set1_ps(height));
+            }
+            ClassifyLanesSSE42(x, y, width, height, (1u << std::min(count - i, 4)) - 1, i, masks);
+        }
+        return masks;
+    }
+
+    RASTERIZER_TARGET("sse4.2")
+    inline CullMasks ClassifyScreenTrianglesSSE42(const float *screenX, const float *screenY, int32_t count, float width, float height)
+    {
+        CullMasks masks = {};
+        for(int i = 0; i < count; i += 4)
+        {
+            int v[4];
+            for(int lane = 0; lane < 4; ++lane)
+            {
+                v[lane] = std::min(i + lane, count - 1) * 3;
+            }
+            __m128 x[3], y[3];
+            for(int k = 0; k < 3; ++k)
+            {
+                x[k] = _mm_setr_ps(screenX[v[0] + k], screenX[v[1] + k], screenX[v[2] + k], screenX[v[3] + k]);
+                y[k] = _mm_setr_ps(screenY[v[0] + k], screenY[v[1] + k], screenY[v[2] + k], screenY[v[3] + k]);
+            }
+            ClassifyLanesSSE42(x, y, width, height, (1u << std::min(count - i, 4)) - 1, i, masks);
+        }
+        return masks;
+    }
+
+    RASTERIZER_TARGET("avx2")
+    inline CullMasks ClassifyLanesAVX2(const __m256 x[3], const __m256 y[3], float width, float height, uint32_t valid)
+    {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 zero = _mm256_setzero_ps();
+        __m256 area = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(x[1], x[0]), _mm256_sub_ps(y[2], y[0])), _mm256_mul_ps(_mm256_sub_ps(x[2], x[0]), _mm256_sub_ps(y[1], y[0])));
+        __m256 onScreen = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(_mm256_add_ps(_mm256_max_ps(_mm256_max_ps(x[0], x[1]), x[2]), one), zero, _CMP_GT_OQ),
+                                                      _mm256_cmp_ps(_mm256_add_ps(_mm256_max_ps(_mm256_max_ps(y[0], y[1]), y[2]), one), zero, _CMP_GT_OQ)),
+                                        _mm256_and_ps(_mm256_cmp_ps(_mm256_sub_ps(_mm256_min_ps(_mm256_min_ps(x[0], x[1]), x[2]), one), _mm256_set1_ps(width), _CMP_LT_OQ),
+                                                      _mm256_cmp_ps(_mm256_sub_ps(_mm256_min_ps(_mm256_min_ps(y[0], y[1]), y[2]), one), _mm256_set1_ps(height), _CMP_LT_OQ)));
+        CullMasks masks;
+        masks.Front = _mm256_movemask_ps(_mm256_cmp_ps(area, zero, _CMP_GT_OQ)) & valid;
+        masks.Back = _mm256_movemask_ps(_mm256_cmp_ps(area, zero, _CMP_LT_OQ)) & valid;
+        masks.OffScreen = ~_mm256_movemask_ps(onScreen) & (masks.Front | masks.Back);
+        return masks;
+    }
+
+    RASTERIZER_TARGET("avx2")
+    inline CullMasks ClassifyTrianglesAVX2(const float *vertices, int32_t count, float width, float height)
+    {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        // Lanes past count gather the last triangle and are masked off
+        __m256i base = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(count - 1)), _mm256_set1_epi32(9));
+        __m256 x[3], y[3];
+        for(int k = 0; k < 3; ++k)
+        {
+            __m256i index = _mm256_add_epi32(base, _mm256_set1_epi32(k * 3));
+            x[k] = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_i32gather_ps(vertices, index, 4), one), half), _mm256_set1_ps(width));
+            y[k] = _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_i32gather_ps(vertices + 1, index, 4), one), half), _mm256_set1_ps(height));
+        }
+        return ClassifyLanesAVX2(x, y, width, height, (1u << count) - 1);
+    }
+
+    RASTERIZER_TARGET("avx2")
+    inline CullMasks ClassifyScreenTrianglesAVX2(const float *screenX, const float *screenY, int32_t count, float width, float height)
+    {
+        __m256i base = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(count - 1)), _mm256_set1_epi32(3));
+        __m256 x[3], y[3];
+        for(int k = 0; k < 3; ++k)
+        {
+            __m256i index = _mm256_add_epi32(base, _mm256_set1_epi32(k));
+            x[k] = _mm256_i32gather_ps(screenX, index, 4);
+            y[k] = _mm256_i32gather_ps(screenY, index, 4);
+        }
+        return ClassifyLanesAVX2(x, y, width, height, (1u << count) - 1);
+    }
+
+    // Outcode bits of the clip-space planes, a vertex c is inside for dot(plane, c) >= 0. The
+    // guard band planes sit at |x| = GuardX * w and |y| = GuardY * w, see VertexTransform.
+    constexpr uint32_t ClipLeft = 1;
+    constexpr uint32_t ClipRight = 2;
+    constexpr uint32_t ClipBottom = 4;
+    constexpr uint32_t ClipTop = 8;
+    constexpr uint32_t ClipNear = 16;
+    constexpr uint32_t ClipFar = 32;
+    constexpr uint32_t GuardLeft = 64;
+    constexpr uint32_t GuardRight = 128;
+    constexpr uint32_t GuardBottom = 256;
+    constexpr uint32_t GuardTop = 512;
+    constexpr int ClipPlanes = 10;
+
+    // Vertex stage of the structure-of-arrays front end. Vertex i is (x[i], y[i], z[i], 1), it is
+    // transformed to clip space by Matrix, divided by w and mapped to pixels with the expression
+    // of the setup, (ndc + 1) * 0.5 * size. Outcodes gets the Clip* and Guard* bits the vertex is
+    // outside of, NaN is outside. The matrix products are fused multiply-adds in every kernel,
+    // std::fma in the scalar one, so all of them produce the same bits.
+    struct VertexTransform
+    {
+        float Matrix[16]; // column-major, the layout of glm::mat4
+        float Width, Height;
+        float GuardX, GuardY;
+    };
+
+    inline void TransformVerticesScalar(const VertexTransform &transform, const float *x, const float *y, const float *z, int32_t count,
+                                        float *screenX, float *screenY, uint32_t *outcodes)
+    {
+        const float *m = transform.Matrix;
+        for(int i = 0; i < count; ++i)
+        {
+            float cx = std::fma(m[0], x[i], std::fma(m[4], y[i], std::fma(m[8], z[i], m[12])));
+            float cy = std::fma(m[1], x[i], std::fma(m[5], y[i], std::fma(m[9], z[i], m[13])));
+            float cz = std::fma(m[2], x[i], std::fma(m[6], y[i], std::fma(m[10], z[i], m[14])));
+            float cw = std::fma(m[3], x[i], std::fma(m[7], y[i], std::fma(m[11], z[i], m[15])));
+            uint32_t code = 0;
+            code |= !(cx + cw >= 0) ? ClipLeft : 0;
+            code |= !(cw - cx >= 0) ? ClipRight : 0;
+            code |= !(cy + cw >= 0) ? ClipBottom : 0;
+            code |= !(cw - cy >= 0) ? ClipTop : 0;
+            code |= !(cz + cw >= 0) ? ClipNear : 0;
+            code |= !(cw - cz >= 0) ? ClipFar : 0;
+            code |= !(std::fma(transform.GuardX, cw, cx) >= 0) ? GuardLeft : 0;
+            code |= !(std::fma(transform.GuardX, cw, -cx) >= 0) ? GuardRight : 0;
+            code |= !(std::fma(transform.GuardY, cw, cy) >= 0) ? GuardBottom : 0;
+            code |= !(std::fma(transform.GuardY, cw, -cy) >= 0) ? GuardTop : 0;
+            screenX[i] = (cx / cw + 1.0f) * 0.5f * transform.Width;
+            screenY[i] = (cy / cw + 1.0f) * 0.5f * transform.Height;
+            outcodes[i] = code;
+        }
+    }
+
+    // `bit` in the lanes where distance is not >= 0
+    RASTERIZER_TARGET("avx2")
+    inline __m256i OutcodeAVX2(__m256 distance, uint32_t bit)
+    {
+        return _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_NGE_UQ)), _mm256_set1_epi32(bit));
+    }
+
+    // 8 vertices per iteration, the tail goes through the scalar kernel
+    RASTERIZER_TARGET("avx2,fma")
+    inline void TransformVerticesAVX2(const VertexTransform &transform, const float *x, const float *y, const float *z, int32_t count,
+                                      float *screenX, float *screenY, uint32_t *outcodes)
+    {
+        __m256 m[16];
+        for(int j = 0; j < 16; ++j)
+        {
+            m[j] = _mm256_set1_ps(transform.Matrix[j]);
+        }
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 width = _mm256_set1_ps(transform.Width);
+        const __m256 height = _mm256_set1_ps(transform.Height);
+        const __m256 guardX = _mm256_set1_ps(transform.GuardX);
+        const __m256 guardY = _mm256_set1_ps(transform.GuardY);
+        int i = 0;
+        for(; i + 8 <= count; i += 8)
+        {
+            __m256 px = _mm256_loadu_ps(x + i);
+            __m256 py = _mm256_loadu_ps(y + i);
+            __m256 pz = _mm256_loadu_ps(z + i);
+            __m256 cx = _mm256_fmadd_ps(m[0], px, _mm256_fmadd_ps(m[4], py, _mm256_fmadd_ps(m[8], pz, m[12])));
+            __m256 cy = _mm256_fmadd_ps(m[1], px, _mm256_fmadd_ps(m[5], py, _mm256_fmadd_ps(m[9], pz, m[13])));
+            __m256 cz = _mm256_fmadd_ps(m[2], px, _mm256_fmadd_ps(m[6], py, _mm256_fmadd_ps(m[10], pz, m[14])));
+            __m256 cw = _mm256_fmadd_ps(m[3], px, _mm256_fmadd_ps(m[7], py, _mm256_fmadd_ps(m[11], pz, m[15])));
+            __m256i code = _mm256_or_si256(_mm256_or_si256(OutcodeAVX2(_mm256_add_ps(cx, cw), ClipLeft), OutcodeAVX2(_mm256_sub_ps(cw, cx), ClipRight)),
+                                           _mm256_or_si256(OutcodeAVX2(_mm256_add_ps(cy, cw), ClipBottom), OutcodeAVX2(_mm256_sub_ps(cw, cy), ClipTop)));
+            code = _mm256_or_si256(code, _mm256_or_si256(OutcodeAVX2(_mm256_add_ps(cz, cw), ClipNear), OutcodeAVX2(_mm256_sub_ps(cw, cz), ClipFar)));
+            code = _mm256_or_si256(code, _mm256_or_si256(OutcodeAVX2(_mm256_fmadd_ps(guardX, cw, cx), GuardLeft),
+                                                         OutcodeAVX2(_mm256_fmsub_ps(guardX, cw, cx), GuardRight)));
+            code = _mm256_or_si256(code, _mm256_or_si256(OutcodeAVX2(_mm256_fmadd_ps(guardY, cw, cy), GuardBottom),
+                                                         OutcodeAVX2(_mm256_fmsub_ps(guardY, cw, cy), GuardTop)));
+            _mm256_storeu_ps(screenX + i, _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_div_ps(cx, cw), one), half), width));
+            _mm256_storeu_ps(screenY + i, _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_div_ps(cy, cw), one), half), height));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(outcodes + i), code);
+        }
+        TransformVerticesScalar(transform, x + i, y + i, z + i, count - i, screenX + i, screenY + i, outcodes + i);
+    }
+
+    RASTERIZER_TARGET("avx512f")
+    inline __m512i OutcodeAVX512(__m512i code, __m512 distance, uint32_t bit)
+    {
+        return _mm512_mask_or_epi32(code, _mm512_cmp_ps_mask(distance, _mm512_setzero_ps(), _CMP_NGE_UQ), code, _mm512_set1_epi32(bit));
+    }
+
+    // 16 vertices per iteration, the tail is a masked iteration
+    RASTERIZER_TARGET("avx512f")
+    inline void TransformVerticesAVX512(const VertexTransform &transform, const float *x, const float *y, const float *z, int32_t count,
+                                        float *screenX, float *screenY, uint32_t *outcodes)
+    {
+        __m512 m[16];
+        for(int j = 0; j < 16; ++j)
+        {
+            m[j] = _mm512_set1_ps(transform.Matrix[j]);
+        }
+        const __m512 one = _mm512_set1_ps(1.0f);
+        const __m512 half = _mm512_set1_ps(0.5f);
+        const __m512 width = _mm512_set1_ps(transform.Width);
+        const __m512 height = _mm512_set1_ps(transform.Height);
+        const __m512 guardX = _mm512_set1_ps(transform.GuardX);
+        const __m512 guardY = _mm512_set1_ps(transform.GuardY);
+        for(int i = 0; i < count; i += 16)
+        {
+            __mmask16 lanes = count - i >= 16 ? static_cast<__mmask16>(0xFFFF) : static_cast<__mmask16>((1u << (count - i)) - 1);
+            __m512 px = _mm512_maskz_loadu_ps(lanes, x + i);
+            __m512 py = _mm512_maskz_loadu_ps(lanes, y + i);
+            __m512 pz = _mm512_maskz_loadu_ps(lanes, z + i);
+            __m512 cx = _mm512_fmadd_ps(m[0], px, _mm512_fmadd_ps(m[4], py, _mm512_fmadd_ps(m[8], pz, m[12])));
+            __m512 cy = _mm512_fmadd_ps(m[1], px, _mm512_fmadd_ps(m[5], py, _mm512_fmadd_ps(m[9], pz, m[13])));
+            __m512 cz = _mm512_fmadd_ps(m[2], px, _mm512_fmadd_ps(m[6], py, _mm512_fmadd_ps(m[10], pz, m[14])));
+            __m512 cw = _mm512_fmadd_ps(m[3], px, _mm512_fmadd_ps(m[7], py, _mm512_fmadd_ps(m[11], pz, m[15])));
+            __m512i code = _mm512_setzero_si512();
+            code = OutcodeAVX512(code, _mm512_add_ps(cx, cw), ClipLeft);
+            code = OutcodeAVX512(code, _mm512_sub_ps(cw, cx), ClipRight);
+            code = OutcodeAVX512(code, _mm512_add_ps(cy, cw), ClipBottom);
+            code = OutcodeAVX512(code, _mm512_sub_ps(cw, cy), ClipTop);
+            code = OutcodeAVX512(code, _mm512_add_ps(cz, cw), ClipNear);
+            code = OutcodeAVX512(code, _mm512_sub_ps(cw, cz), ClipFar);
+            code = OutcodeAVX512(code, _mm512_fmadd_ps(guardX, cw, cx), GuardLeft);
+            code = OutcodeAVX512(code, _mm512_fmsub_ps(guardX, cw, cx), GuardRight);
+            code = OutcodeAVX512(code, _mm512_fmadd_ps(guardY, cw, cy), GuardBottom);
+            code = OutcodeAVX512(code, _mm512_fmsub_ps(guardY, cw, cy), GuardTop);
+            _mm512_mask_storeu_ps(screenX + i, lanes, _mm512_mul_ps(_mm512_mul_ps(_mm512_add_ps(_mm512_div_ps(cx, cw), one), half), width));
+            _mm512_mask_storeu_ps(screenY + i, lanes, _mm512_mul_ps(_mm512_mul_ps(_mm512_add_ps(_mm512_div_ps(cy, cw), one), half), height));
+            _mm512_mask_storeu_epi32(outcodes + i, lanes, code);
+        }
+    }
+
+    template <typename MaskT>
+    using CoverageKernel = void (*)(const TileRow<MaskT> &row, int32_t x0, int32_t count, MaskT *out);
+    template <typename MaskT>
+    using CoverageKernelFixed = void (*)(const TileRowFixed<MaskT> &row, int32_t x0, int32_t count, MaskT *out);
+    template <typename MaskT>
+    using WriteTileKernel = void (*)(uint8_t *dst, int32_t stride, MaskT mask);
+    using SetupKernel = void (*)(TriangleBatch &batch, int32_t count, float width, float height, float quantization);
+    using CullKernel = CullMasks (*)(const float *vertices, int32_t count, float width, float height);
+    using ScreenCullKernel = CullMasks (*)(const float *screenX, const float *screenY, int32_t count, float width, float height);
+    using TransformKernel = void (*)(const VertexTransform &transform, const float *x, const float *y, const float *z, int32_t count,
+                                     float *screenX, float *screenY, uint32_t *outcodes);
+
+    template <typename MaskT>
+    struct KernelSet
+    {
+        KernelIsa Isa;
+        CoverageKernel<MaskT> CoverageRow;
+        CoverageKernelFixed<MaskT> CoverageRowFixed;
+        WriteTileKernel<MaskT> WriteTile;
+        SetupKernel SetupTriangles;
+        CullKernel ClassifyTriangles;
+        ScreenCullKernel ClassifyScreenTriangles;
+        TransformKernel TransformVertices;
+    };
+
+    struct CpuFeatures
+    {
+        bool SSE42 = false;
+        bool AVX2 = false;
+        bool FMA = false;
+        bool BMI2 = false;
+        bool AVX512F = false;
+        bool AVX512BW = false;
+    };
+
+    inline void CpuId(int32_t info[4], int32_t leaf, int32_t subleaf)
+    {
+#if defined(_MSC_VER)
+        __cpuidex(info, leaf, subleaf);
+#else
+        unsigned int a, b, c, d;
+        __cpuid_count(leaf, subleaf, a, b, c, d);
+        info[0] = a; info[1] = b; info[2] = c; info[3] = d;
+#endif
+    }
+
+    // Register state the OS saves on context switch, AVX/AVX-512 are unusable without it
+    inline uint64_t GetXCR0()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        uint32_t eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+    }
+
+    inline CpuFeatures DetectCpuFeatures()
+    {
+        CpuFeatures features;
+        int32_t info[4];
+        CpuId(info, 0, 0);
+        int32_t maxLeaf = info[0];
+        if(maxLeaf < 1)
+        {
+            return features;
+        }
+        CpuId(info, 1, 0);
+        features.SSE42 = (info[2] >> 20) & 1;
+        bool osxsave = (info[2] >> 27) & 1;
+        bool avx = (info[2] >> 28) & 1;
+        uint64_t xcr0 = osxsave ? GetXCR0() : 0;
+        bool osAVX = avx && (xcr0 & 0x6) == 0x6;           // XMM | YMM
+        bool osAVX512 = osAVX && (xcr0 & 0xE0) == 0xE0;    // opmask | ZMM_Hi256 | Hi16_ZMM
+        features.FMA = osAVX && ((info[2] >> 12) & 1);
+        if(maxLeaf >= 7)
+        {
+            CpuId(info, 7, 0);
+            features.AVX2 = osAVX && ((info[1] >> 5) & 1);
+            features.BMI2 = (info[1] >> 8) & 1;
+            features.AVX512F = osAVX512 && ((info[1] >> 16) & 1);
+            features.AVX512BW = osAVX512 && ((info[1] >> 30) & 1);
+        }
+        return features;
+    }
+
+    inline bool IsSupported(KernelIsa isa, const CpuFeatures &cpu)
+    {
+        switch(isa)
+        {
+            case KernelIsa::Scalar: return true;
+            case KernelIsa::SSE42:  return cpu.SSE42;
+            case KernelIsa::AVX2:   return cpu.AVX2;
+            case KernelIsa::AVX512: return cpu.AVX512F && cpu.AVX512BW;
+            default:                return false;
+        }
+    }
+
+    inline const char *IsaName(KernelIsa isa)
+    {
+        switch(isa)
+        {
+            case KernelIsa::Scalar: return "scalar";
+            case KernelIsa::SSE42:  return "sse42";
+            case KernelIsa::AVX2:   return "avx2";
+            case KernelIsa::AVX512: return "avx512";
+            default:                return "auto";
+        }
+    }
+
+    // Accepts the names returned by IsaName, anything else means Auto
+    inline KernelIsa ParseIsa(const char *name)
+    {
+        if(name == nullptr)
+        {
+            return KernelIsa::Auto;
+        }
+        std::string lower(name);
+        std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        for(KernelIsa isa : { KernelIsa::Scalar, KernelIsa::SSE42, KernelIsa::AVX2, KernelIsa::AVX512 })
+        {
+            if(lower == IsaName(isa))
+            {
+                return isa;
+            }
+        }
+        return KernelIsa::Auto;
+    }
+
+    // Resolves the requested ISA against the RASTERIZER_ISA override and the host CPU,
+    // a forced ISA the host cannot run falls back to the best supported one and the caller
+    // compares the Isa of the returned set with its request. The gather and tile expansion
+    // kernels are written for 64-bit masks, other grid sizes top out at SSE4.2.
+    // The vertex transform does not depend on the masks and needs FMA, below AVX2 it is scalar.
+    template <int GridSize, int32_t OffsetSample>
+    inline KernelSet<TileMask<GridSize>> SelectKernels(KernelIsa requested)
+    {
+        using MaskT = TileMask<GridSize>;
+        if(requested == KernelIsa::Auto)
+        {
+            requested = ParseIsa(std::getenv("RASTERIZER_ISA"));
+        }
+        CpuFeatures cpu = DetectCpuFeatures();
+        KernelIsa isa = requested;
+        if(isa == KernelIsa::Auto || !IsSupported(isa, cpu))
+        {
+            isa = KernelIsa::Scalar;
+            for(KernelIsa candidate : { KernelIsa::AVX512, KernelIsa::AVX2, KernelIsa::SSE42 })
+            {
+                if(IsSupported(candidate, cpu))
+                {
+                    isa = candidate;
+                    break;
+                }
+            }
+        }
+
+        TransformKernel transform = TransformVerticesScalar;
+        if(isa == KernelIsa::AVX512)
+        {
+            transform = TransformVerticesAVX512;
+        }
+        else if(isa == KernelIsa::AVX2 && cpu.FMA)
+        {
+            transform = TransformVerticesAVX2;
+        }
+
+        if constexpr(GridSize == 8)
+        {
+            switch(isa)
+            {
+                case KernelIsa::AVX512: return { isa, CoverageRowAVX512<OffsetSample>, CoverageRowFixedAVX512<OffsetSample>, WriteTileAVX512, SetupTrianglesAVX2, ClassifyTrianglesAVX2, ClassifyScreenTrianglesAVX2, transform };
+                case KernelIsa::AVX2:   return { isa, CoverageRowAVX2<OffsetSample>, CoverageRowFixedAVX2<OffsetSample>, WriteTileAVX2, SetupTrianglesAVX2, ClassifyTrianglesAVX2, ClassifyScreenTrianglesAVX2, transform };
+                case KernelIsa::SSE42:  return { isa, CoverageRowSSE42<OffsetSample, MaskT>, CoverageRowFixedSSE42<OffsetSample, MaskT>, WriteTileSSE42, SetupTrianglesSSE42, ClassifyTrianglesSSE42, ClassifyScreenTrianglesSSE42, transform };
+                default:                return { KernelIsa::Scalar, CoverageRowScalar<OffsetSample, MaskT>, CoverageRowFixedScalar<OffsetSample, MaskT>, WriteTileScalar, SetupTrianglesScalar, ClassifyTrianglesScalar, ClassifyScreenTrianglesScalar, transform };
+            }
+        }
+        else
+        {
+            if(isa != KernelIsa::Scalar)
+            {
+                return { KernelIsa::SSE42, CoverageRowSSE42<OffsetSample, MaskT>, CoverageRowFixedSSE42<OffsetSample, MaskT>, WriteTileRows<GridSize, MaskT>, SetupTrianglesSSE42, ClassifyTrianglesSSE42, ClassifyScreenTrianglesSSE42, transform };
+            }
+            return { KernelIsa::Scalar, CoverageRowScalar<OffsetSample, MaskT>, CoverageRowFixedScalar<OffsetSample, MaskT>, WriteTileRows<GridSize, MaskT>, SetupTrianglesScalar, ClassifyTrianglesScalar, ClassifyScreenTrianglesScalar, transform };
+        }
+    }
+}
@@ -40,7 +40,7 @@ int main()
     Rasterizer rasterizer(SCR_WIDTH, SCR_HEIGHT);
     {
         auto start_time = std::chrono::high_resolution_clock::now();
-        std::cout << "Rasterization started." << std::endl;
+        std::cout << "Rasterization started (" << RasterKernels::IsaName(rasterizer.GetKernelIsa()) << " kernels)." << std::endl;
         // Perform rasterization
         std::cout << "Rasterizing " << randomTriangles.size() / 3 << " triangles." << std::endl;
         rasterizer.RasterizePrototype3(randomTriangles);
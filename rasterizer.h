@@ -2,26 +2,166 @@
 #include <cstdint>
 #include <vector>
 #include <cmath>
-#include <intrin.h>
-#include <immintrin.h>
 #include <glm/glm.hpp>
+#include "kernels.h"
+#include "tables.h"
+#include "tablecache.h"
+#include "threadpool.h"
 #include "utils.h"
 #include <algorithm>
+#include <cstring>
+#include <new>
+#include <memory>
+#include <climits>
 
-class Rasterizer
+// Keeps framebuffer tiles on cache line boundaries
+template <typename T, size_t Alignment>
+struct AlignedAllocator
+{
+    using value_type = T;
+    template <typename U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() = default;
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+    void deallocate(T *p, size_t)
+    {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+    template <typename U> bool operator==(const AlignedAllocator<U, Alignment> &) const { return true; }
+    template <typename U> bool operator!=(const AlignedAllocator<U, Alignment> &) const { return false; }
+};
+
+enum class FrameBufferLayout
+{
+    Linear, // row-major, mWidth bytes per row
+    Tiled,   // GridSize x GridSize tiles of contiguous bytes (one cache line for 8x8), tiles row-major
+    Coverage // binary coverage only, one TileMask per tile (same bit order as BitMaskTable), tiles row-major
+};
+
+enum class ParallelMode
+{
+    SortMiddle, // triangles are binned into screen regions, each region is rasterized by one thread
+    SortLast    // triangles are spread over threads, tile coverage is merged with atomic ORs
+};
+
+// Winding the culling stage drops, counter-clockwise with y up is the front face. Degenerate and
+// off-screen triangles are dropped in every mode.
+enum class CullMode
+{
+    None,  // both windings are rasterized, back faces are reordered to the front winding
+    Back,  // back faces cover no pixel under the edge functions, culling them only saves the traversal
+    Front  // only back faces are rasterized
+};
+
+struct RasterizerOptions
+{
+    RasterKernels::KernelIsa Isa = RasterKernels::KernelIsa::Auto; // force a kernel set, e.g. for benchmarking, GetKernelIsa() reports a fallback
+    FrameBufferLayout Layout = FrameBufferLayout::Linear;
+    bool HierarchicalTraversal = true; // super-tiles of SuperTileSize^2 tiles with trivial accept/reject
+    bool RowSpans = true;              // per tile row, only visit the tiles between the triangle's edges
+    bool FixedPoint = false;           // snapped 16.8 vertices and integer edge setup, deterministic across machines,
+                                       // triangles reaching past the guard band are clipped there
+    bool SymmetricTable = false;       // store one octant of masks, the others are flipped/transposed at lookup
+    std::string TableCachePath;        // map the tables from this file, written on a miss; empty or unusable uses the built-in tables
+    bool TableHugePages = false;       // hint huge pages for the mapped table file
+    int Threads = 1;                   // > 1 runs RasterizePrototype3 in parallel, 0 uses every hardware thread
+    ParallelMode Parallel = ParallelMode::SortMiddle;
+    int BinSize = 128;                 // edge of a SortMiddle screen bin in pixels, rounded up to whole tiles
+    int SplitTiles = 1024;             // SortLast, triangles over this many tiles are split into jobs of about as many tiles
+    CullMode Cull = CullMode::Back;
+    bool ClipGuardBand = false;        // RasterizeClipSpace also clips triangles that reach past the guard band, always on with FixedPoint
+};
+
+// Structure-of-arrays vertex positions of RasterizeStreams, vertex i is (X[i], Y[i], Z[i], 1)
+struct VertexStreams
+{
+    const float *X = nullptr;
+    const float *Y = nullptr;
+    const float *Z = nullptr;
+    int Count = 0;
+};
+
+// Triangle and tile counters of the draws, accumulated until ResetTraversalStats. Every input
+// triangle is submitted once and counted in at most one of the Triangles* fates, a triangle cut
+// by the clipping counts as kept whatever happens to its pieces.
+struct TraversalStats
+{
+    uint64_t TrianglesSubmitted = 0;
+    uint64_t TrianglesDegenerate = 0; // zero or NaN area
+    uint64_t TrianglesFaceCulled = 0; // winding dropped by the CullMode
+    uint64_t TrianglesOffScreen = 0;  // or outside the frustum
+    uint64_t TrianglesOutOfRange = 0; // FixedPoint, unclipped vertices past the guard band
+    uint64_t TilesInBounds = 0; // tiles of all triangle bounding boxes
+    uint64_t TilesLookedUp = 0; // tiles that went through the BitMaskTable lookup
+    uint64_t TilesFilled = 0;   // tiles of trivially accepted super-tiles
+    uint64_t TilesSkipped = 0;  // tiles of trivially rejected super-tiles or outside the row spans
+    uint64_t SuperTilesAccepted = 0;
+    uint64_t SuperTilesRejected = 0;
+    uint64_t SuperTilesPartial = 0;
+
+    TraversalStats &operator+=(const TraversalStats &other)
+    {
+        TrianglesSubmitted += other.TrianglesSubmitted;
+        TrianglesDegenerate += other.TrianglesDegenerate;
+        TrianglesFaceCulled += other.TrianglesFaceCulled;
+        TrianglesOffScreen += other.TrianglesOffScreen;
+        TrianglesOutOfRange += other.TrianglesOutOfRange;
+        TilesInBounds += other.TilesInBounds;
+        TilesLookedUp += other.TilesLookedUp;
+        TilesFilled += other.TilesFilled;
+        TilesSkipped += other.TilesSkipped;
+        SuperTilesAccepted += other.SuperTilesAccepted;
+        SuperTilesRejected += other.SuperTilesRejected;
+        SuperTilesPartial += other.SuperTilesPartial;
+        return *this;
+    }
+
+    double SkippedFraction() const
+    {
+        return TilesInBounds ? static_cast<double>(TilesSkipped) / TilesInBounds : 0.0;
+    }
+};
+
+// GridSize is the tile edge in pixels (4, 8 or 16), QuantizationResolution the number of table
+// angles per octant of edge directions and OffsetSample the number of table entries per angle.
+// Mask type, table layout and kernels all follow from these at compile time.
+template <int GridSizeT, int32_t QuantizationResolutionT, int32_t OffsetSampleT>
+class BasicRasterizer
 {
 
     public:
-        constexpr inline static int GridSize = 8;
-        constexpr inline static float GridRange = 32; // 4 * sqrt(2)
-        constexpr inline static int32_t QuantizationResolution = 64;
-        constexpr inline static int32_t OffsetSample = 64;
-        Rasterizer(int32_t width, int32_t height) : mWidth(width), mHeight(height)
+        constexpr inline static int GridSize = GridSizeT;
+        constexpr inline static float GridRange = RasterTables::GridRange<GridSize>;
+        constexpr inline static int32_t QuantizationResolution = QuantizationResolutionT;
+        constexpr inline static int32_t OffsetSample = OffsetSampleT;
+        using Mask = RasterKernels::TileMask<GridSize>;
+
+        BasicRasterizer(int32_t width, int32_t height, const RasterizerOptions &options = {})
+            : mWidth(width), mHeight(height), mLayout(options.Layout),
+              mHierarchicalTraversal(options.HierarchicalTraversal), mRowSpans(options.RowSpans), mFixedPoint(options.FixedPoint),
+              mSymmetricTable(options.SymmetricTable), mTableCachePath(options.TableCachePath),
+              mTableHugePages(options.TableHugePages)
         {
-            FrameBuffer.resize(mWidth * mHeight, 0);
+            mKernels = RasterKernels::SelectKernels<GridSize, OffsetSample>(options.Isa);
+            mBinTiles = std::max(1, (options.BinSize + GridSize - 1) / GridSize);
+            mParallelMode = options.Parallel;
+            mSplitTiles = std::max(1, options.SplitTiles);
+            mCullMode = options.Cull;
+            mClipGuardBand = options.ClipGuardBand;
+            if(options.Threads != 1)
+            {
+                mPool = std::make_unique<ThreadPool>(options.Threads);
+                mWorkerScratch.resize(mPool->Participants());
+            }
+            AllocateFrameBuffer();
             PrecomputeRasterizationData();
         }
-        ~Rasterizer()
+        ~BasicRasterizer()
         {
             if(textureData)
             {
@@ -30,10 +170,100 @@ class Rasterizer
             }
         }
 
-        unsigned char *textureData = nullptr;
-        GLuint GetFrameBufferTexture()
+        // Only the framebuffer is reallocated, the tables are shared and independent of the size
+        void Resize(int32_t width, int32_t height)
         {
-            textureData = new unsigned char[mWidth * mHeight * 4]; // 4 channels (RGBA)
+            mWidth = width;
+            mHeight = height;
+            if(textureData)
+            {
+                delete [] textureData;
+                textureData = nullptr;
+            }
+            AllocateFrameBuffer();
+        }
+
+        RasterKernels::KernelIsa GetKernelIsa() const
+        {
+            return mKernels.Isa;
+        }
+
+        // False if TableCachePath is empty or the file could not be used and the built-in tables are bound
+        bool IsTableFileMapped() const
+        {
+            return mTableFile != nullptr;
+        }
+
+        FrameBufferLayout GetFrameBufferLayout() const
+        {
+            return mLayout;
+        }
+
+        const TraversalStats &GetTraversalStats() const
+        {
+            return mScratch.Stats;
+        }
+
+        void ResetTraversalStats()
+        {
+            mScratch.Stats = {};
+        }
+
+        // Tile masks of the Coverage layout, mTilesX * mTilesY entries. Bits of border tiles
+        // beyond mWidth/mHeight may be set, the resolve functions drop them.
+        const std::vector<Mask, AlignedAllocator<Mask, 64>> &GetCoverageBuffer() const
+        {
+            return CoverageBuffer;
+        }
+
+        // Row-major R8 copy of the framebuffer (mWidth * mHeight bytes) whatever the internal layout
+        void ResolveFrameBuffer(uint8_t *dst) const
+        {
+            if(mLayout == FrameBufferLayout::Linear)
+            {
+                std::memcpy(dst, FrameBuffer.data(), FrameBuffer.size());
+                return;
+            }
+            if(mLayout == FrameBufferLayout::Coverage)
+            {
+                for(int y = 0; y < mHeight; ++y)
+                {
+                    const Mask *tileMasks = &CoverageBuffer[(y / GridSize) * mTilesX];
+                    for(int tx = 0; tx < mTilesX; ++tx)
+                    {
+                        uint32_t bits = RasterKernels::RowBits<GridSize>(tileMasks[tx], y % GridSize);
+                        int columns = std::min(GridSize, mWidth - tx * GridSize);
+                        for(int gx = 0; gx < columns; gx += 8)
+                        {
+                            uint64_t pixels = RasterKernels::ExpandRowScalar((bits >> gx) & 0xFF);
+                            std::memcpy(dst + y * mWidth + tx * GridSize + gx, &pixels, std::min(columns - gx, 8));
+                        }
+                    }
+                }
+                return;
+            }
+            for(int y = 0; y < mHeight; ++y)
+            {
+                const uint8_t *tileRow = &FrameBuffer[(y / GridSize) * mTilesX * GridSize * GridSize + (y % GridSize) * GridSize];
+                for(int tx = 0; tx < mTilesX; ++tx)
+                {
+                    int columns = std::min(GridSize, mWidth - tx * GridSize);
+                    std::memcpy(dst + y * mWidth + tx * GridSize, tileRow + tx * GridSize * GridSize, columns);
+                }
+            }
+        }
+
+        std::vector<uint8_t> GetLinearFrameBuffer() const
+        {
+            std::vector<uint8_t> linear(mWidth * mHeight);
+            ResolveFrameBuffer(linear.data());
+            return linear;
+        }
+
+        // RGBA8 visualization (mWidth * mHeight * 4 bytes), covered pixels get a UV gradient
+        void ResolveFrameBufferRGBA(unsigned char *dst) const
+        {
+            std::vector<uint8_t> frameBuffer = GetLinearFrameBuffer();
             for (int y = 0; y < mHeight; ++y)
             {
                 for (int x = 0; x < mWidth; ++x)
@@ -41,149 +271,174 @@ class Rasterizer
                     int idx = (y * mWidth + x) * 4;
                     float u = static_cast<float>(x) / (mWidth - 1);
                     float v = static_cast<float>(mHeight - y - 1) / (mHeight - 1);
-                    if(FrameBuffer[y * mWidth + x] > 0)
+                    if(frameBuffer[y * mWidth + x] > 0)
                     {
-                        textureData[idx + 0] = static_cast<unsigned char>(128); // R
-                        textureData[idx + 1] = static_cast<unsigned char>(u * 255); // G
-                        textureData[idx + 2] = static_cast<unsigned char>(v * 255); // B
-                        textureData[idx + 3] = 255; // A
+                        dst[idx + 0] = static_cast<unsigned char>(128); // R
+                        dst[idx + 1] = static_cast<unsigned char>(u * 255); // G
+                        dst[idx + 2] = static_cast<unsigned char>(v * 255); // B
+                        dst[idx + 3] = 255; // A
                     }
                     else
                     {
-                        textureData[idx + 0] = 0; // R
-                        textureData[idx + 1] = 0; // G
-                        textureData[idx + 2] = 0; // B
-                        textureData[idx + 3] = 255; // A
+                        dst[idx + 0] = 0; // R
+                        dst[idx + 1] = 0; // G
+                        dst[idx + 2] = 0; // B
+                        dst[idx + 3] = 255; // A
                     }
                 }
             }
+        }
+
+        unsigned char *textureData = nullptr;
+        GLuint GetFrameBufferTexture()
+        {
+            textureData = new unsigned char[mWidth * mHeight * 4]; // 4 channels (RGBA)
+            ResolveFrameBufferRGBA(textureData);
             return LoadTextureFromArray(textureData, mWidth, mHeight, GL_REPEAT, false);
         }
 
 
         void RasterizePrototype3(std::vector<glm::vec3> &vertices)
         {
-            for(int i = 0; i < vertices.size(); i+=3)
+            int whole = 0;
+            if(mFixedPoint && CutAtGuardBand(vertices, whole))
             {
-                glm::vec3 v0 = vertices[i];
-                glm::vec3 v1 = vertices[i+1];
-                glm::vec3 v2 = vertices[i+2];
-                // NDC to Screen
-                v0 = (v0 + 1.0f) * 0.5f * glm::vec3(mWidth, mHeight, 1.0f);
-                v1 = (v1 + 1.0f) * 0.5f * glm::vec3(mWidth, mHeight, 1.0f);
-                v2 = (v2 + 1.0f) * 0.5f * glm::vec3(mWidth, mHeight, 1.0f);
-                // Bounding Box
-                int minX = (int)std::floor(std::min({v0.x, v1.x, v2.x}));
-                int maxX =  (int)std::ceil(std::max({v0.x, v1.x, v2.x}));
-                int minY = (int)std::floor(std::min({v0.y, v1.y, v2.y}));
-                int maxY =  (int)std::ceil(std::max({v0.y, v1.y, v2.y}));
-
-                // Edge Equation
-                glm::vec2 e0 = glm::vec2(v0.x - v1.x, v0.y - v1.y);
-                glm::vec2 e1 = glm::vec2(v1.x - v2.x, v1.y - v2.y);
-                glm::vec2 e2 = glm::vec2(v2.x - v0.x, v2.y - v0.y);
-                float c0 = v0.x * v1.y - v0.y * v1.x;
-                float c1 = v1.x * v2.y - v1.y * v2.x;
-                float c2 = v2.x * v0.y - v2.y * v0.x;
-                glm::vec2 n0 = glm::normalize(glm::vec2(e0.y, -e0.x));
-                glm::vec2 n1 = glm::normalize(glm::vec2(e1.y, -e1.x));
-                glm::vec2 n2 = glm::normalize(glm::vec2(e2.y, -e2.x));
-
-                glm::vec3 line0 = glm::vec3(n0, c0 / glm::length(e0));
-                glm::vec3 line1 = glm::vec3(n1, c1 / glm::length(e1));
-                glm::vec3 line2 = glm::vec3(n2, c2 / glm::length(e2));
-
-
-                minY = minY / GridSize;
-                maxY = (maxY / GridSize)  + ((maxY % GridSize)? 1: 0);
-                minX = minX / GridSize ;
-                maxX = (maxX / GridSize)  + ((maxX % GridSize)? 1: 0);
-
-
-                float deltax0 = line0.x * GridSize;
-                float deltay0 = line0.y * GridSize;
-                float deltax1 = line1.x * GridSize;
-                float deltay1 = line1.y * GridSize;
-                float deltax2 = line2.x * GridSize;
-                float deltay2 = line2.y * GridSize;
-
-                float Offset0 = line0.z + deltay0 * minY;
-                float Offset1 = line1.z + deltay1 * minY;
-                float Offset2 = line2.z + deltay2 * minY;
-
-                int slopeIdxX0 = static_cast<int>((line0.x + 1.0f) * 0.5f * (QuantizationResolution - 1));
-                int slopeIdxY0 = static_cast<int>((line0.y + 1.0f) * 0.5f * (QuantizationResolution - 1));
-
-                int slopeIdxX1 = static_cast<int>((line1.x + 1.0f) * 0.5f * (QuantizationResolution - 1));
-                int slopeIdxY1 = static_cast<int>((line1.y + 1.0f) * 0.5f * (QuantizationResolution - 1));
+                RasterizeTriangles(mClipped, whole);
+                return;
+            }
+            RasterizeTriangles(vertices, static_cast<int>(vertices.size() / 3));
+        }
 
-                int slopeIdxX2 = static_cast<int>((line2.x + 1.0f) * 0.5f * (QuantizationResolution - 1));
-                int slopeIdxY2 = static_cast<int>((line2.y + 1.0f) * 0.5f * (QuantizationResolution - 1));
+        // Front end for clip-space input: positions, 3 per triangle, are transformed by mvp, clipped
+        // against the near plane (and the guard band with RasterizerOptions::ClipGuardBand), divided
+        // by w and rasterized like RasterizePrototype3, which does the viewport transform. Clip space
+        // is the OpenGL one of glm, a vertex is inside the frustum for -w <= x, y, z <= w.
+        void RasterizeClipSpace(const std::vector<glm::vec4> &positions, const glm::mat4 &mvp)
+        {
+            int triangles = static_cast<int>(positions.size() / 3);
+            if(!mPool)
+            {
+                // Batches stay in cache from the transform to the traversal
+                for(int first = 0; first < triangles; first += CullBatch)
+                {
+                    mScratch.Clipped.clear();
+                    mScratch.ClipPieces.clear();
+                    ClipTriangles(&positions[first * 3], std::min(CullBatch, triangles - first), mvp, mScratch.Clipped, mScratch.ClipPieces, mScratch.Stats);
+                    int whole = static_cast<int>(mScratch.Clipped.size() / 3);
+                    mScratch.Clipped.insert(mScratch.Clipped.end(), mScratch.ClipPieces.begin(), mScratch.ClipPieces.end());
+                    RasterizeSerial(mScratch.Clipped.data(), static_cast<int>(mScratch.Clipped.size() / 3), whole);
+                }
+                return;
+            }
 
-                uint32_t IdxPre0 = (slopeIdxY0 << 12) | (slopeIdxX0 << 6);
-                uint32_t IdxPre1 = (slopeIdxY1 << 12) | (slopeIdxX1 << 6);
-                uint32_t IdxPre2 = (slopeIdxY2 << 12) | (slopeIdxX2 << 6);
+            // Clipped in parallel, then gathered for the parallel modes: the whole triangles in
+            // submission order, followed by the pieces of the cut ones
+            int jobs = (triangles + ClipBatch - 1) / ClipBatch;
+            if(static_cast<int>(mClipJobs.size()) < jobs * 2)
+            {
+                mClipJobs.resize(jobs * 2);
+            }
+            mPool->ParallelFor(jobs, [&](int job, int participant)
+            {
+                int first = job * ClipBatch;
+                mClipJobs[job].clear();
+                mClipJobs[jobs + job].clear();
+                ClipTriangles(&positions[first * 3], std::min(ClipBatch, triangles - first), mvp, mClipJobs[job], mClipJobs[jobs + job],
+                              mWorkerScratch[participant].Stats);
+            });
+            std::vector<size_t> offsets(jobs * 2 + 1, 0);
+            for(int part = 0; part < jobs * 2; ++part)
+            {
+                offsets[part + 1] = offsets[part] + mClipJobs[part].size();
+            }
+            mClipped.resize(offsets[jobs * 2]);
+            mPool->ParallelFor(jobs * 2, [&](int part, int)
+            {
+                std::copy(mClipJobs[part].begin(), mClipJobs[part].end(), mClipped.begin() + offsets[part]);
+            });
+            RasterizeTriangles(mClipped, static_cast<int>(offsets[jobs] / 3));
+        }
 
-                for(int y = minY; y < maxY; ++y)
+        // Front end for large meshes kept as structure-of-arrays streams, 3 consecutive vertices per
+        // triangle. TransformVertices takes 8 (AVX2) or 16 (AVX-512) vertices per instruction from
+        // the streams to pixels, and the culling and batched setup read those pixel streams, so no
+        // triangle is copied on the way. Triangles that need the near plane or guard band cut go
+        // through ClipTriangles like RasterizeClipSpace. With threads in ParallelMode::SortLast,
+        // batches are rasterized in parallel into shared coverage and large triangles are not split.
+        // ParallelMode::SortMiddle bins copies of the triangles anyway, so there the triangles are
+        // gathered into a list and drawn by RasterizeClipSpace.
+        void RasterizeStreams(const VertexStreams &streams, const glm::mat4 &mvp)
+        {
+            if(GathersTriangles())
+            {
+                auto position = StreamPosition(streams);
+                GatherTriangles(streams.Count / 3, mGatheredPositions, [&](int i, int k) { return position(static_cast<uint32_t>(i * 3 + k)); });
+                RasterizeClipSpace(mGatheredPositions, mvp);
+                return;
+            }
+            RasterKernels::VertexTransform transform = MakeVertexTransform(mvp);
+            RunScreenBatches(streams.Count / 3, [&](int first, int count, TileScratch &scratch)
+            {
+                ReserveScreenBatch(scratch, count);
+                int v = first * 3;
+                mKernels.TransformVertices(transform, streams.X + v, streams.Y + v, streams.Z + v, count * 3,
+                                           scratch.ScreenX.data(), scratch.ScreenY.data(), scratch.Outcodes.data());
+                RasterizeScreenBatch(count, mvp, scratch, [&](int i, glm::vec4 positions[3])
                 {
-                    float currentOffset0 = Offset0 + deltax0 * minX;
-                    float currentOffset1 = Offset1 + deltax1 * minX;
-                    float currentOffset2 = Offset2 + deltax2 * minX;
-                    for(int x = minX; x < maxX; ++x)
+                    for(int k = 0; k < 3; ++k)
                     {
-                        int offsetIdx0 = static_cast<int>((currentOffset0 / GridRange - 0.5f) * OffsetSample);
-                        offsetIdx0 = std::clamp(offsetIdx0, 0, OffsetSample - 1);
-                        int offsetIdx1 = static_cast<int>((currentOffset1 / GridRange - 0.5f) * OffsetSample);
-                        offsetIdx1 = std::clamp(offsetIdx1, 0, OffsetSample - 1);
-                        int offsetIdx2 = static_cast<int>((currentOffset2 / GridRange - 0.5f) * OffsetSample);
-                        offsetIdx2 = std::clamp(offsetIdx2, 0, OffsetSample - 1);
+                        positions[k] = glm::vec4(streams.X[v + i * 3 + k], streams.Y[v + i * 3 + k], streams.Z[v + i * 3 + k], 1.0f);
+                    }
+                });
+            });
+        }
 
-                        uint32_t tableIdx0 = IdxPre0 | offsetIdx0;
-                        uint32_t tableIdx1 = IdxPre1 | offsetIdx1;
-                        uint32_t tableIdx2 = IdxPre2 | offsetIdx2;
+        // Indexed triangle lists, 3 indices per triangle into the vertices, which every index must
+        // be inside of. The whole vertex buffer is transformed once up front, in parallel with
+        // threads, and the triangles gather their corners from the result, so a vertex shared by
+        // several triangles is never transformed twice. Otherwise the same as RasterizeStreams.
+        template <typename IndexT>
+        void RasterizeIndexed(const VertexStreams &vertices, const std::vector<IndexT> &indices, const glm::mat4 &mvp)
+        {
+            static_assert(std::is_same_v<IndexT, uint32_t> || std::is_same_v<IndexT, uint16_t>, "indices are uint32_t or uint16_t");
+            DrawIndexed(vertices, mvp, static_cast<int>(indices.size() / 3), ListCorners(indices));
+        }
 
-                        uint64_t d0 = BitMaskTable[tableIdx0];
-                        uint64_t d1 = BitMaskTable[tableIdx1];
-                        uint64_t d2 = BitMaskTable[tableIdx2];
+        // Same for NDC vertices as RasterizePrototype3 takes them, the pre-pass is the viewport transform
+        template <typename IndexT>
+        void RasterizeIndexed(const std::vector<glm::vec3> &vertices, const std::vector<IndexT> &indices)
+        {
+            static_assert(std::is_same_v<IndexT, uint32_t> || std::is_same_v<IndexT, uint16_t>, "indices are uint32_t or uint16_t");
+            DrawIndexed(vertices, static_cast<int>(indices.size() / 3), ListCorners(indices));
+        }
 
-                        // uint64_t d0 = BitMaskTable2D[slopeIdxY0][slopeIdxX0][offsetIdx0];
-                        // uint64_t d1 = BitMaskTable2D[slopeIdxY1][slopeIdxX1][offsetIdx1];
-                        // uint64_t d2 = BitMaskTable2D[slopeIdxY2][slopeIdxX2][offsetIdx2];
+        // Triangle strips: triangle i is vertices i, i + 1, i + 2, with the first two swapped for odd
+        // i so the strip keeps one winding, as in OpenGL. Every vertex is transformed once by the
+        // RasterizeIndexed pre-pass, so a strip reads about one vertex per triangle.
+        void RasterizeStrip(const VertexStreams &vertices, const glm::mat4 &mvp)
+        {
+            DrawIndexed(vertices, mvp, std::max(vertices.Count - 2, 0), StripCorners);
+        }
 
-                        uint64_t finalBitmask = d0 & d1 & d2;
+        void RasterizeStrip(const std::vector<glm::vec3> &vertices)
+        {
+            DrawIndexed(vertices, std::max(static_cast<int>(vertices.size()) - 2, 0), StripCorners);
+        }
 
-                        for(int gy = 0; gy < GridSize; ++gy)
-                        {
-                            for(int gx = 0; gx < GridSize; ++gx)
-                            {
-                                int pixelX = x * GridSize + gx;
-                                int pixelY = y * GridSize + gy;
-                               
-                                int bitIdx = gy * GridSize + gx;
-                                if(finalBitmask & (1ull << bitIdx))
-                                {
-                                    int fbIdx = pixelY * mWidth + pixelX;
-                                    if(fbIdx >= 0 && fbIdx < mWidth * mHeight)
-                                    {
-                                        FrameBuffer[fbIdx] = 255;
-                                    }
-                                }
-                            }
-                        }
-                        currentOffset0 += deltax0;
-                        currentOffset1 += deltax1;
-                        currentOffset2 += deltax2;
-                    }
-                    Offset0 += deltay0;
-                    Offset1 += deltay1;
-                    Offset2 += deltay2;
-                }
-            }
+        // Triangle fans: triangle i is vertices 0, i + 1, i + 2. Otherwise the same as RasterizeStrip.
+        void RasterizeFan(const VertexStreams &vertices, const glm::mat4 &mvp)
+        {
+            DrawIndexed(vertices, mvp, std::max(vertices.Count - 2, 0), FanCorners);
+        }
+
+        void RasterizeFan(const std::vector<glm::vec3> &vertices)
+        {
+            DrawIndexed(vertices, std::max(static_cast<int>(vertices.size()) - 2, 0), FanCorners);
         }
 
         void RasterizePrototype2(std::vector<glm::vec3> &vertices)
         {
-            for(int i = 0; i < vertices.size(); i+=3)
+            for(size_t i = 0; i < vertices.size(); i+=3)
             {
                 glm::vec3 v0 = vertices[i];
                 glm::vec3 v1 = vertices[i+1];
@@ -192,11 +447,11 @@ class Rasterizer
                 v0 = (v0 + 1.0f) * 0.5f * glm::vec3(mWidth, mHeight, 1.0f);
                 v1 = (v1 + 1.0f) * 0.5f * glm::vec3(mWidth, mHeight, 1.0f);
                 v2 = (v2 + 1.0f) * 0.5f * glm::vec3(mWidth, mHeight, 1.0f);
-                // Bounding Box
-                int minX = (int)std::floor(std::min({v0.x, v1.x, v2.x}));
-                int maxX =  (int)std::ceil(std::max({v0.x, v1.x, v2.x}));
-                int minY = (int)std::floor(std::min({v0.y, v1.y, v2.y}));
-                int maxY =  (int)std::ceil(std::max({v0.y, v1.y, v2.y}));
+                // Bounding Box, clamped to the screen before the float to int conversion
+                int minX = (int)std::floor(std::clamp(std::min({v0.x, v1.x, v2.x}), 0.0f, (float)mWidth));
+                int maxX =  (int)std::ceil(std::clamp(std::max({v0.x, v1.x, v2.x}), 0.0f, (float)mWidth));
+                int minY = (int)std::floor(std::clamp(std::min({v0.y, v1.y, v2.y}), 0.0f, (float)mHeight));
+                int maxY =  (int)std::ceil(std::clamp(std::max({v0.y, v1.y, v2.y}), 0.0f, (float)mHeight));
 
                 // Edge Equation
                 glm::vec2 e0 = glm::vec2(v0.x - v1.x, v0.y - v1.y);
@@ -214,10 +469,10 @@ class Rasterizer
                 glm::vec3 line2 = glm::vec3(n2, c2 / glm::length(e2));
 
 
-                minY = minY / GridSize;
-                maxY = (maxY / GridSize)  + ((maxY % GridSize)? 1: 0);
-                minX = minX / GridSize ;
-                maxX = (maxX / GridSize)  + ((maxX % GridSize)? 1: 0);
+                minY = std::max(FloorDiv(minY, GridSize), 0);
+                maxY = std::min(CeilDiv(maxY, GridSize), mTilesY);
+                minX = std::max(FloorDiv(minX, GridSize), 0);
+                maxX = std::min(CeilDiv(maxX, GridSize), mTilesX);
 
 
                 float deltax0 = line0.x * GridSize;
@@ -238,9 +493,12 @@ class Rasterizer
                     float currentOffset2 = Offset2 + deltax2 * minX;
                     for(int x = minX; x < maxX; ++x)
                     {
-                        for(int gy = 0; gy < GridSize; ++gy)
+                        // Border tiles stop at the screen edge
+                        int rows = std::min(GridSize, mHeight - y * GridSize);
+                        int columns = std::min(GridSize, mWidth - x * GridSize);
+                        for(int gy = 0; gy < rows; ++gy)
                         {
-                            for(int gx = 0; gx < GridSize; ++gx)
+                            for(int gx = 0; gx < columns; ++gx)
                             {
                                 int pixelX = x * GridSize + gx;
                                 int pixelY = y * GridSize + gy;
@@ -249,8 +507,7 @@ class Rasterizer
                                 float d2 = line2.x * (gx + 0.5f) + line2.y * (gy + 0.5f) + currentOffset2;
                                 if(d0 >= 0 && d1 >= 0 && d2 >= 0)
                                 {
-                                    int fbIdx = pixelY * mWidth + pixelX;
-                                    FrameBuffer[fbIdx] = 255;
+                                    SetPixel(pixelX, pixelY);
                                 }
                             }
                         }
@@ -267,7 +524,7 @@ class Rasterizer
 
         void RasterizePrototype1(std::vector<glm::vec3> &vertices)
         {
-            for(int i = 0; i < vertices.size(); i+=3)
+            for(size_t i = 0; i < vertices.size(); i+=3)
             {
                 glm::vec3 v0 = vertices[i];
                 glm::vec3 v1 = vertices[i+1];
@@ -276,11 +533,11 @@ class Rasterizer
                 v0 = (v0 + 1.0f) * 0.5f * glm::vec3(mWidth, mHeight, 1.0f);
                 v1 = (v1 + 1.0f) * 0.5f * glm::vec3(mWidth, mHeight, 1.0f);
                 v2 = (v2 + 1.0f) * 0.5f * glm::vec3(mWidth, mHeight, 1.0f);
-                // Bounding Box
-                int minX = (int)std::floor(std::min({v0.x, v1.x, v2.x}));
-                int maxX =  (int)std::ceil(std::max({v0.x, v1.x, v2.x}));
-                int minY = (int)std::floor(std::min({v0.y, v1.y, v2.y}));
-                int maxY =  (int)std::ceil(std::max({v0.y, v1.y, v2.y}));
+                // Bounding Box, clamped to the screen before the float to int conversion
+                int minX = (int)std::floor(std::clamp(std::min({v0.x, v1.x, v2.x}), 0.0f, (float)mWidth));
+                int maxX =  (int)std::ceil(std::clamp(std::max({v0.x, v1.x, v2.x}), 0.0f, (float)mWidth));
+                int minY = (int)std::floor(std::clamp(std::min({v0.y, v1.y, v2.y}), 0.0f, (float)mHeight));
+                int maxY =  (int)std::ceil(std::clamp(std::max({v0.y, v1.y, v2.y}), 0.0f, (float)mHeight));
 
                 // Edge Equation
                 glm::vec2 e0 = glm::vec2(v0.x - v1.x, v0.y - v1.y);
@@ -298,19 +555,22 @@ class Rasterizer
                 glm::vec3 line2 = glm::vec3(n2, c2 / glm::length(e2));
 
 
-                minY = minY / GridSize;
-                maxY = (maxY / GridSize)  + ((maxY % GridSize)? 1: 0);
-                minX = minX / GridSize ;
-                maxX = (maxX / GridSize)  + ((maxX % GridSize)? 1: 0);
+                minY = std::max(FloorDiv(minY, GridSize), 0);
+                maxY = std::min(CeilDiv(maxY, GridSize), mTilesY);
+                minX = std::max(FloorDiv(minX, GridSize), 0);
+                maxX = std::min(CeilDiv(maxX, GridSize), mTilesX);
 
 
                 for(int y = minY; y < maxY; ++y)
                 {
                     for(int x = minX; x < maxX; ++x)
                     {
-                        for(int gy = 0; gy < GridSize; ++gy)
+                        // Border tiles stop at the screen edge
+                        int rows = std::min(GridSize, mHeight - y * GridSize);
+                        int columns = std::min(GridSize, mWidth - x * GridSize);
+                        for(int gy = 0; gy < rows; ++gy)
                         {
-                            for(int gx = 0; gx < GridSize; ++gx)
+                            for(int gx = 0; gx < columns; ++gx)
                             {
                                 int pixelX = x * GridSize + gx;
                                 int pixelY = y * GridSize + gy;
@@ -320,8 +580,7 @@ class Rasterizer
                                 float d2 = line2.x * (pixelX + 0.5f) + line2.y * (pixelY + 0.5f) + line2.z;
                                 if(d0 >= 0 && d1 >= 0 && d2 >= 0)
                                 {
-                                    int fbIdx = pixelY * mWidth + pixelX;
-                                    FrameBuffer[fbIdx] = 255;
+                                    SetPixel(pixelX, pixelY);
                                 }
                             }
                         }
@@ -333,48 +592,1799 @@ class Rasterizer
     private:
         int32_t mWidth;
         int32_t mHeight;
-        std::vector<uint64_t> BitMaskTable;
-        std::vector<std::vector<std::vector<uint64_t>>> BitMaskTable2D; // [QuantizationResolution][QuantizationResolution][OffsetSample]
-        std::vector<uint8_t> FrameBuffer; // R8
+        // RasterTables::Tables, [AngleSamples][OffsetSample] or [QuantizationResolution][OffsetSample] if symmetric
+        const Mask *BitMaskTable;
+        const int32_t *FirstNonEmptyOffset; // per angle, smallest offset index with a non-empty mask
+        const int32_t *FirstFullOffset;     // per angle, smallest offset index with a full mask
+        int32_t mTilesX;
+        int32_t mTilesY;
+        FrameBufferLayout mLayout;
+        std::vector<uint8_t, AlignedAllocator<uint8_t, 64>> FrameBuffer; // R8, see FrameBufferLayout
+        std::vector<Mask, AlignedAllocator<Mask, 64>> CoverageBuffer; // FrameBufferLayout::Coverage
 
-        void PrecomputeRasterizationData()
+        RasterKernels::KernelSet<Mask> mKernels;
+        bool mHierarchicalTraversal;
+        bool mRowSpans;
+        bool mFixedPoint;
+        bool mSymmetricTable;
+        std::string mTableCachePath;
+        bool mTableHugePages;
+        std::shared_ptr<const RasterTables::SharedTableFile> mTableFile; // backs the table pointers when mTableCachePath is set
+
+        constexpr inline static int TileBatch = 64;     // tiles per coverage kernel call
+        constexpr inline static int SuperTileSize = 8;  // in tiles, 64x64 pixels for 8x8 tiles
+        constexpr inline static int SubpixelBits = 8;   // fixed-point vertex precision, 16.8
+        // Triangles are not clipped to the screen. Their edges are set up whole and only their
+        // bounds are clamped, so the parts off screen are never traversed. The fixed-point snap
+        // takes vertices up to this many pixels around the screen center, 16 integer bits keep the
+        // edge functions inside int64.
+        constexpr inline static int GuardBand = 1 << 16;
+        constexpr inline static int BinBatch = 4096;    // triangles per binning job
+        constexpr inline static int CullBatch = 1024;   // triangles culled at a time by the single-threaded path
+        constexpr inline static int ClipBatch = 4096;   // triangles per clipping job of the multi-threaded path
+        constexpr inline static int VertexBatch = 16384; // vertices per job of the RasterizeIndexed pre-pass
+
+        // Per-thread working memory of the traversal
+        struct TileScratch
         {
-            constexpr float SlopeScale = 1.f / 512 * 6.283185307f;
-            BitMaskTable.resize(QuantizationResolution * QuantizationResolution * OffsetSample, 0);
-            BitMaskTable2D.resize(QuantizationResolution, std::vector<std::vector<uint64_t>>(QuantizationResolution, std::vector<uint64_t>(OffsetSample, 0)));
-            for(int i = 0; i < 512; ++i)
-            {
-                float angle = (float)i * SlopeScale; // 2 * PI
-                float nx = std::cos(angle);
-                float ny = std::sin(angle);
+            std::vector<float> RowOffsets;       // 3 offset indices per tile row of the current triangle
+            std::vector<int64_t> RowOffsetsFixed; // same for the fixed-point setup
+            std::vector<int> RowSpanBounds;      // first and one-past-last tile per tile row of the current triangle
+            TraversalStats Stats;
+            Mask *SharedCoverage = nullptr;      // SortLast and threaded RunScreenBatches, tiles are ORed atomically into these mTilesX * mTilesY masks
+            std::vector<glm::vec3> Visible;      // triangles that survived CullTriangles, grows to the largest batch
+            std::vector<glm::vec3> Clipped;      // RasterizeClipSpace batch after clipping and the perspective divide
+            std::vector<glm::vec3> ClipPieces;   // pieces of the triangles ClipTriangles cut, appended to Clipped
+            std::vector<float> ScreenX;          // RasterizeStreams and RasterizeIndexed batch in pixels, 3 per triangle
+            std::vector<float> ScreenY;
+            std::vector<uint32_t> Outcodes;
+            std::vector<uint32_t> VisibleIndices; // survivors of CullScreenTriangles, triangle << 1 | flipped
+        };
 
-                // Remapping to [0, QuantizationResolution] for indexing
-                int slopeIdxX = static_cast<int>((nx + 1.0f) * 0.5f * (QuantizationResolution - 1));
-                int slopeIdxY = static_cast<int>((ny + 1.0f) * 0.5f * (QuantizationResolution - 1));
+        // Tiles [X0, X1) x [Y0, Y1) a traversal may touch
+        struct TileRect
+        {
+            int X0, X1, Y0, Y1;
+        };
+        constexpr inline static TileRect AllTiles = { INT_MIN, INT_MAX, INT_MIN, INT_MAX };
 
-                for(int k = 0; k < OffsetSample; ++k)
-                {
-                    float nk = ((float)k / OffsetSample - 0.5f) * GridRange; // -GridRange/2 ~ GridRange/2
-                    uint64_t bitmask = 0;
-                    for(int x = 0; x < 8; ++x)
-                    {
-                        for(int y = 0; y < 8; ++y)
-                        {
-                            float sampleX = (float)(x) + 0.5f;
-                            float sampleY = (float)(y) + 0.5f;
+        // Tile bounds and per-edge data of one triangle, consumed by TraverseTiles.
+        // TileRowT is RasterKernels::TileRow for the float setup or TileRowFixed for the integer one.
+        template <typename TileRowT>
+        struct TriangleTiles
+        {
+            using OffsetType = typename TileRowT::OffsetType;
+            int MinX, MaxX, MinY, MaxY; // tile bounds, max exclusive
+            TileRowT Row;               // Masks and DeltaX, Offset is filled per row
+            const OffsetType *RowOffsets; // 3 offset indices per tile row from MinY
+            const int *RowSpans;        // first and one-past-last tile per tile row from MinY, nullptr for the whole box
+            int FirstNonEmpty[3];       // see FirstNonEmptyOffset
+            int FirstFull[3];           // see FirstFullOffset
+        };
 
-                            float dist = sampleX * nx + sampleY * ny + nk;
+        TileScratch mScratch; // single-threaded path, its Stats also collect the binned ones
+        int mBinTiles;        // bin edge in tiles
+        ParallelMode mParallelMode;
+        int mSplitTiles;
+        CullMode mCullMode;
+        bool mClipGuardBand;
+        std::vector<glm::vec3> mClipped;                 // clipped NDC triangles, RasterizeClipSpace with threads and CutAtGuardBand
+        std::vector<std::vector<glm::vec3>> mClipJobs;   // whole triangles per job, then pieces per job, multi-threaded path
+        std::vector<float> mVertexX;                     // RasterizeIndexed pre-pass, pixels per vertex
+        std::vector<float> mVertexY;
+        std::vector<uint32_t> mVertexOutcodes;
+        std::vector<glm::vec4> mGatheredPositions;       // stream triangles as a list, see GathersTriangles
+        std::vector<glm::vec3> mGatheredVertices;
+        std::unique_ptr<ThreadPool> mPool; // binned mode when set
+        std::vector<TileScratch> mWorkerScratch; // per pool participant
+        // Tile rows [Y0, Y1) of one large triangle
+        struct SplitJob
+        {
+            const glm::vec3 *Triangle; // into mLargeTriangles
+            int Y0, Y1;
+        };
 
-                            int Idx = y * 8 + x;
+        std::vector<std::vector<std::vector<glm::vec3>>> mBinJobs; // [job][bin], triangle vertices in submission order
+        std::vector<Mask, AlignedAllocator<Mask, 64>> mSortLastCoverage; // shared coverage of the Linear and Tiled layouts, see BeginSharedCoverage
+        std::vector<std::vector<glm::vec3>> mLargeTriangles; // SortLast, per job, vertices of the culled triangles over mSplitTiles
+        std::vector<SplitJob> mSplitJobs;
 
-                            bitmask |= (dist >= 0) ? (1ull << Idx) : 0;
-                        }
-                    }
+        enum class BlockCoverage { Empty, Partial, Full };
+
+        constexpr inline static int AngleSamples = 8 * QuantizationResolution;
+
+        static constexpr uint32_t TableIndex(int angleIdx, int offsetIdx)
+        {
+            return static_cast<uint32_t>(angleIdx) * OffsetSample + offsetIdx;
+        }
+
+        // Edge directions are bucketed per octant: the signs of nx and ny and which of them is larger
+        // pick the octant, the ratio of the smaller to the larger component (tan of the angle to the
+        // nearest axis) picks one of QuantizationResolution equal steps inside it.
+        // The octant bits are laid out as the ApplySymmetry ops that map octant 0 onto it, steep is
+        // MaskTranspose, nx < 0 is MaskFlipX and ny < 0 is MaskFlipY. The symmetric table only has
+        // octant 0 and hands these ops to the kernels, the full table has every octant and no ops.
+        int OctantAngle(int octant, int step, uint8_t &symmetry) const
+        {
+            step = std::clamp(step, 0, QuantizationResolution - 1); // NaN lines convert to negative steps
+            symmetry = mSymmetricTable ? static_cast<uint8_t>(octant) : 0;
+            return mSymmetricTable ? step : octant * QuantizationResolution + step;
+        }
+
+        int AngleIndex(int64_t nx, int64_t ny, uint8_t &symmetry) const
+        {
+            int64_t ax = std::abs(nx);
+            int64_t ay = std::abs(ny);
+            bool steep = ay > ax;
+            int64_t step = steep ? ax * QuantizationResolution / ay : ay * QuantizationResolution / ax;
+            int octant = (ny < 0) << 2 | (nx < 0) << 1 | steep;
+            return OctantAngle(octant, static_cast<int>(step), symmetry);
+        }
+
+        // A flipped mask is read at the mirrored tile corner, which is one tile step further along
+        // the flipped axis, so the edge's offset index moves by that step
+        template <typename T>
+        static T SymmetryShift(uint8_t symmetry, T deltaX, T deltaY)
+        {
+            return ((symmetry & RasterKernels::MaskFlipX) ? deltaX : T(0)) + ((symmetry & RasterKernels::MaskFlipY) ? deltaY : T(0));
+        }
+
+        // Same arithmetic as the coverage kernels
+        static int OffsetIndex(float rowOffset, float deltaX, int x)
+        {
+            return RasterKernels::ClampedOffsetIndex<OffsetSample>(rowOffset + deltaX * static_cast<float>(x));
+        }
+
+        static int OffsetIndex(int64_t rowOffset, int32_t deltaX, int x)
+        {
+            int64_t offsetIdx = (rowOffset + static_cast<int64_t>(deltaX) * x) >> RasterKernels::FixedShift;
+            return static_cast<int>(std::clamp<int64_t>(offsetIdx, 0, OffsetSample - 1));
+        }
+
+        // Tile column where the offset index of an edge reaches `threshold`, clamped to [first, last].
+        // Only a starting point for ComputeRowSpan, which snaps it with OffsetIndex.
+        static int SpanEstimate(float rowOffset, float deltaX, int threshold, int first, int last)
+        {
+            float estimate = (threshold - rowOffset) / deltaX;
+            return std::isnan(estimate) ? first : static_cast<int>(std::floor(std::clamp(estimate, (float)first, (float)last)));
+        }
+
+        static int SpanEstimate(int64_t rowOffset, int32_t deltaX, int threshold, int first, int last)
+        {
+            int64_t estimate = ((static_cast<int64_t>(threshold) << RasterKernels::FixedShift) - rowOffset) / deltaX;
+            return static_cast<int>(std::clamp<int64_t>(estimate, first, last));
+        }
+
+        void CoverageRow(const RasterKernels::TileRow<Mask> &row, int32_t x0, int32_t count, Mask *out) const
+        {
+            mKernels.CoverageRow(row, x0, count, out);
+        }
+
+        void CoverageRow(const RasterKernels::TileRowFixed<Mask> &row, int32_t x0, int32_t count, Mask *out) const
+        {
+            mKernels.CoverageRowFixed(row, x0, count, out);
+        }
+
+        // Floor and ceiling of a / b for b > 0, negative a included
+        static int FloorDiv(int a, int b)
+        {
+            return a / b - (a % b < 0);
+        }
+        static int CeilDiv(int a, int b)
+        {
+            return -FloorDiv(-a, b);
+        }
+
+        // floor(sqrt(value)), exact for the whole range so the fixed-point setup stays deterministic
+        static int64_t IntegerSqrt(int64_t value)
+        {
+            int64_t root = static_cast<int64_t>(std::sqrt(static_cast<double>(value)));
+            while(root > 0 && root * root > value)
+            {
+                --root;
+            }
+            while((root + 1) * (root + 1) <= value)
+            {
+                ++root;
+            }
+            return root;
+        }
+
+        // RasterizePrototype3 for the options, the first `counted` triangles are counted in the
+        // stats and the others are pieces of clipped triangles that were counted whole
+        void RasterizeTriangles(const std::vector<glm::vec3> &vertices, int counted)
+        {
+            if(mPool && mParallelMode == ParallelMode::SortLast)
+            {
+                if(mFixedPoint)
+                {
+                    RasterizeSortLast<RasterKernels::TileRowFixed<Mask>>(vertices, counted);
+                }
+                else
+                {
+                    RasterizeSortLast<RasterKernels::TileRow<Mask>>(vertices, counted);
+                }
+                return;
+            }
+            if(mPool)
+            {
+                if(mFixedPoint)
+                {
+                    RasterizeBinned<RasterKernels::TileRowFixed<Mask>>(vertices, counted);
+                }
+                else
+                {
+                    RasterizeBinned<RasterKernels::TileRow<Mask>>(vertices, counted);
+                }
+                return;
+            }
+            RasterizeSerial(vertices.data(), static_cast<int>(vertices.size() / 3), counted);
+        }
 
-                    uint32_t tableIdx = slopeIdxY << 12 | slopeIdxX << 6 | k;
-                    BitMaskTable[tableIdx] = bitmask;
-                    BitMaskTable2D[slopeIdxY][slopeIdxX][k] = bitmask;
+        // Single-threaded path of RasterizeTriangles, CullBatch triangles at a time
+        void RasterizeSerial(const glm::vec3 *vertices, int triangles, int counted)
+        {
+            auto traverse = [&](auto &tri, int) { TraverseTiles(tri, mScratch, AllTiles); };
+            for(int first = 0; first < triangles; first += CullBatch)
+            {
+                int visible = CullTriangles(&vertices[first * 3], std::min(CullBatch, triangles - first), counted - first, mScratch);
+                if(mFixedPoint)
+                {
+                    SetupTriangles<RasterKernels::TileRowFixed<Mask>>(mScratch.Visible.data(), visible, mScratch, traverse);
+                }
+                else
+                {
+                    SetupTriangles<RasterKernels::TileRow<Mask>>(mScratch.Visible.data(), visible, mScratch, traverse);
                 }
             }
         }
-};
+
+        RasterKernels::VertexTransform MakeVertexTransform(const glm::mat4 &mvp) const
+        {
+            RasterKernels::VertexTransform transform;
+            for(int column = 0; column < 4; ++column)
+            {
+                for(int row = 0; row < 4; ++row)
+                {
+                    transform.Matrix[column * 4 + row] = mvp[column][row];
+                }
+            }
+            transform.Width = static_cast<float>(mWidth);
+            transform.Height = static_cast<float>(mHeight);
+            transform.GuardX = 2.0f * GuardBand / mWidth;
+            transform.GuardY = 2.0f * GuardBand / mHeight;
+            return transform;
+        }
+
+        // Calls batch(first, count, scratch) for triangles [0, triangles) in pieces of CullBatch. With
+        // threads, which only get here in ParallelMode::SortLast, the pieces run in parallel into
+        // shared coverage.
+        template <typename Batch>
+        void RunScreenBatches(int triangles, Batch &&batch)
+        {
+            if(!mPool)
+            {
+                for(int first = 0; first < triangles; first += CullBatch)
+                {
+                    batch(first, std::min(CullBatch, triangles - first), mScratch);
+                }
+                return;
+            }
+
+            Mask *coverage = BeginSharedCoverage();
+            int jobs = (triangles + CullBatch - 1) / CullBatch;
+            mPool->ParallelFor(jobs, [&](int job, int participant)
+            {
+                TileScratch &scratch = mWorkerScratch[participant];
+                int first = job * CullBatch;
+                scratch.SharedCoverage = coverage;
+                batch(first, std::min(CullBatch, triangles - first), scratch);
+                scratch.SharedCoverage = nullptr;
+            });
+            ResolveSharedCoverage();
+            MergeWorkerStats();
+        }
+
+        static void ReserveScreenBatch(TileScratch &scratch, int triangles)
+        {
+            size_t vertices = static_cast<size_t>(triangles) * 3;
+            if(scratch.ScreenX.size() < vertices)
+            {
+                scratch.ScreenX.resize(vertices);
+                scratch.ScreenY.resize(vertices);
+                scratch.Outcodes.resize(vertices);
+            }
+        }
+
+        // Pre-pass of RasterizeIndexed: transform(first, count) fills vertices [first, first + count)
+        // of mVertexX, mVertexY and mVertexOutcodes, in parallel pieces with threads
+        template <typename Transform>
+        void TransformVertexBuffer(int vertices, Transform &&transform)
+        {
+            mVertexX.resize(vertices);
+            mVertexY.resize(vertices);
+            mVertexOutcodes.resize(vertices);
+            int jobs = (vertices + VertexBatch - 1) / VertexBatch;
+            auto job = [&](int index, int)
+            {
+                int first = index * VertexBatch;
+                transform(first, std::min(VertexBatch, vertices - first));
+            };
+            if(mPool)
+            {
+                mPool->ParallelFor(jobs, job);
+            }
+            else
+            {
+                for(int index = 0; index < jobs; ++index)
+                {
+                    job(index, 0);
+                }
+            }
+        }
+
+        // Pre-pass of RasterizeIndexed, RasterizeStrip and RasterizeFan for stream vertices
+        void TransformVertexStreams(const VertexStreams &vertices, const glm::mat4 &mvp)
+        {
+            RasterKernels::VertexTransform transform = MakeVertexTransform(mvp);
+            TransformVertexBuffer(vertices.Count, [&](int first, int count)
+            {
+                mKernels.TransformVertices(transform, vertices.X + first, vertices.Y + first, vertices.Z + first, count,
+                                           &mVertexX[first], &mVertexY[first], &mVertexOutcodes[first]);
+            });
+        }
+
+        // Same for NDC vertices, the viewport transform
+        void TransformNdcVertices(const std::vector<glm::vec3> &vertices)
+        {
+            TransformVertexBuffer(static_cast<int>(vertices.size()), [&](int first, int count)
+            {
+                for(int i = first; i < first + count; ++i)
+                {
+                    mVertexX[i] = (vertices[i].x + 1.0f) * 0.5f * static_cast<float>(mWidth);
+                    mVertexY[i] = (vertices[i].y + 1.0f) * 0.5f * static_cast<float>(mHeight);
+                    mVertexOutcodes[i] = 0;
+                }
+            });
+        }
+
+        // Clip-space input of vertex `index` for RasterizeIndexedTriangles
+        static auto StreamPosition(const VertexStreams &vertices)
+        {
+            return [&vertices](uint32_t index) { return glm::vec4(vertices.X[index], vertices.Y[index], vertices.Z[index], 1.0f); };
+        }
+
+        static auto NdcPosition(const std::vector<glm::vec3> &vertices)
+        {
+            return [&vertices](uint32_t index) { return glm::vec4(vertices[index], 1.0f); };
+        }
+
+        // Vertex index of corner k of triangle i for RasterizeIndexedTriangles
+        template <typename IndexT>
+        static auto ListCorners(const std::vector<IndexT> &indices)
+        {
+            return [&indices](int i, int k) { return static_cast<uint32_t>(indices[static_cast<size_t>(i) * 3 + k]); };
+        }
+
+        static uint32_t StripCorners(int i, int k)
+        {
+            int odd = i & 1;
+            int swapped = k == 0 ? odd : k == 1 ? 1 - odd : 2;
+            return static_cast<uint32_t>(i + swapped);
+        }
+
+        static uint32_t FanCorners(int i, int k)
+        {
+            return k == 0 ? 0u : static_cast<uint32_t>(i + k);
+        }
+
+        // Threaded ParallelMode::SortMiddle draws of the stream front ends go through the list
+        // front ends, which bin them like RasterizePrototype3
+        bool GathersTriangles() const
+        {
+            return mPool && mParallelMode == ParallelMode::SortMiddle;
+        }
+
+        // Copies vertex(i, k), corner k of triangle i, to a triangle list, in parallel
+        template <typename VertexT, typename Vertex>
+        void GatherTriangles(int triangles, std::vector<VertexT> &list, Vertex &&vertex)
+        {
+            list.resize(static_cast<size_t>(triangles) * 3);
+            int jobs = (triangles + CullBatch - 1) / CullBatch;
+            mPool->ParallelFor(jobs, [&](int job, int)
+            {
+                int end = std::min((job + 1) * CullBatch, triangles);
+                for(int i = job * CullBatch; i < end; ++i)
+                {
+                    for(int k = 0; k < 3; ++k)
+                    {
+                        list[static_cast<size_t>(i) * 3 + k] = vertex(i, k);
+                    }
+                }
+            });
+        }
+
+        // RasterizeIndexed, RasterizeStrip and RasterizeFan of stream vertices: the transform
+        // pre-pass and RasterizeIndexedTriangles, or the gathered list for SortMiddle
+        template <typename Corner>
+        void DrawIndexed(const VertexStreams &vertices, const glm::mat4 &mvp, int triangles, Corner &&corner)
+        {
+            auto position = StreamPosition(vertices);
+            if(GathersTriangles())
+            {
+                GatherTriangles(triangles, mGatheredPositions, [&](int i, int k) { return position(corner(i, k)); });
+                RasterizeClipSpace(mGatheredPositions, mvp);
+                return;
+            }
+            TransformVertexStreams(vertices, mvp);
+            RasterizeIndexedTriangles(triangles, mvp, corner, position);
+        }
+
+        // Same for NDC vertices, the gathered list goes to RasterizePrototype3
+        template <typename Corner>
+        void DrawIndexed(const std::vector<glm::vec3> &vertices, int triangles, Corner &&corner)
+        {
+            if(GathersTriangles())
+            {
+                GatherTriangles(triangles, mGatheredVertices, [&](int i, int k) { return vertices[corner(i, k)]; });
+                RasterizePrototype3(mGatheredVertices);
+                return;
+            }
+            TransformNdcVertices(vertices);
+            // Nothing is clipped without outcodes, the positions are never asked for
+            RasterizeIndexedTriangles(triangles, glm::mat4(1.0f), corner, NdcPosition(vertices));
+        }
+
+        // Triangles of RasterizeIndexed, RasterizeStrip and RasterizeFan, their corners are gathered
+        // from the transformed vertex buffer into the pixel streams of each batch. corner(i, k) is
+        // the vertex index of corner k of triangle i, position(index) is the clip-space input of a
+        // vertex for triangles that need clipping.
+        template <typename Corner, typename Position>
+        void RasterizeIndexedTriangles(int triangles, const glm::mat4 &mvp, Corner &&corner, Position &&position)
+        {
+            RunScreenBatches(triangles, [&](int first, int count, TileScratch &scratch)
+            {
+                ReserveScreenBatch(scratch, count);
+                for(int i = 0; i < count; ++i)
+                {
+                    for(int k = 0; k < 3; ++k)
+                    {
+                        uint32_t index = corner(first + i, k);
+                        scratch.ScreenX[i * 3 + k] = mVertexX[index];
+                        scratch.ScreenY[i * 3 + k] = mVertexY[index];
+                        scratch.Outcodes[i * 3 + k] = mVertexOutcodes[index];
+                    }
+                }
+                RasterizeScreenBatch(count, mvp, scratch, [&](int i, glm::vec4 positions[3])
+                {
+                    for(int k = 0; k < 3; ++k)
+                    {
+                        positions[k] = position(corner(first + i, k));
+                    }
+                });
+            });
+        }
+
+        // Culling, setup and traversal of `count` triangles given by the pixel streams and outcodes
+        // in scratch, 3 entries per triangle, sized so they stay in cache between the stages.
+        // positions(i, p) gives the clip-space input of triangle i to ClipTriangles.
+        template <typename Positions>
+        void RasterizeScreenBatch(int count, const glm::mat4 &mvp, TileScratch &scratch, Positions &&positions)
+        {
+            scratch.Clipped.clear();
+            scratch.ClipPieces.clear();
+            int visible = CullScreenTriangles(count, mvp, scratch, positions);
+
+            // Survivors in the winding the setup takes, back faces that are kept swap their last two vertices
+            auto corners = [&](int i, int index[3])
+            {
+                uint32_t entry = scratch.VisibleIndices[i];
+                int base = static_cast<int>(entry >> 1) * 3;
+                bool flip = entry & 1;
+                index[0] = base;
+                index[1] = base + (flip ? 2 : 1);
+                index[2] = base + (flip ? 1 : 2);
+            };
+            auto pixels = [&](int i, float x[3], float y[3])
+            {
+                int index[3];
+                corners(i, index);
+                for(int k = 0; k < 3; ++k)
+                {
+                    x[k] = scratch.ScreenX[index[k]];
+                    y[k] = scratch.ScreenY[index[k]];
+                }
+            };
+            auto snapped = [&](int i, int64_t X[3], int64_t Y[3])
+            {
+                int index[3];
+                corners(i, index);
+                for(int k = 0; k < 3; ++k)
+                {
+                    if(!SnapPixel(scratch.ScreenX[index[k]], scratch.ScreenY[index[k]], X[k], Y[k]))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            };
+            auto traverse = [&](auto &tri, int) { TraverseTiles(tri, scratch, AllTiles); };
+            int whole = static_cast<int>(scratch.Clipped.size() / 3);
+            scratch.Clipped.insert(scratch.Clipped.end(), scratch.ClipPieces.begin(), scratch.ClipPieces.end());
+            int clipped = static_cast<int>(scratch.Clipped.size() / 3);
+            if(mFixedPoint)
+            {
+                SetupBatch<RasterKernels::TileRowFixed<Mask>>(visible, scratch, pixels, snapped, traverse);
+                int kept = CullTriangles(scratch.Clipped.data(), clipped, whole, scratch);
+                SetupTriangles<RasterKernels::TileRowFixed<Mask>>(scratch.Visible.data(), kept, scratch, traverse);
+            }
+            else
+            {
+                SetupBatch<RasterKernels::TileRow<Mask>>(visible, scratch, pixels, snapped, traverse);
+                int kept = CullTriangles(scratch.Clipped.data(), clipped, whole, scratch);
+                SetupTriangles<RasterKernels::TileRow<Mask>>(scratch.Visible.data(), kept, scratch, traverse);
+            }
+        }
+
+        // Culling stage of RasterizeScreenBatch, on the pixel streams and outcodes in scratch.
+        // Triangles outside one frustum plane are dropped, the ones crossing a plane of ClipCut are
+        // clipped from their positions into scratch.Clipped and scratch.ClipPieces, where
+        // ClipTriangles counts them, and the others are culled like CullTriangles does. The survivors go to scratch.VisibleIndices in submission order, the
+        // return value is how many there are.
+        template <typename Positions>
+        int CullScreenTriangles(int count, const glm::mat4 &mvp, TileScratch &scratch, Positions &&positions) const
+        {
+            if(scratch.VisibleIndices.size() < static_cast<size_t>(count))
+            {
+                scratch.VisibleIndices.resize(count);
+            }
+            uint32_t *out = scratch.VisibleIndices.data();
+            const uint32_t *outcodes = scratch.Outcodes.data();
+            uint32_t cut = ClipCut();
+            TraversalStats &stats = scratch.Stats;
+            for(int group = 0; group < count; group += RasterKernels::CullLanes)
+            {
+                int lanes = std::min(RasterKernels::CullLanes, count - group);
+                uint32_t rejected = 0;
+                uint32_t clipped = 0;
+                for(int lane = 0; lane < lanes; ++lane)
+                {
+                    const uint32_t *c = &outcodes[(group + lane) * 3];
+                    rejected |= static_cast<uint32_t>((c[0] & c[1] & c[2]) != 0) << lane;
+                    clipped |= static_cast<uint32_t>(((c[0] | c[1] | c[2]) & cut) != 0) << lane;
+                }
+                clipped &= ~rejected;
+                stats.TrianglesSubmitted += RasterKernels::PopCount(rejected);
+                stats.TrianglesOffScreen += RasterKernels::PopCount(rejected);
+                for(uint32_t bits = clipped; bits; bits &= bits - 1)
+                {
+                    glm::vec4 triangle[3];
+                    positions(group + RasterKernels::CountTrailingZeros(bits), triangle);
+                    ClipTriangles(triangle, 1, mvp, scratch.Clipped, scratch.ClipPieces, stats);
+                }
+
+                uint32_t tested = ((1u << lanes) - 1) & ~(rejected | clipped);
+                const float *screenX = &scratch.ScreenX[group * 3];
+                const float *screenY = &scratch.ScreenY[group * 3];
+                RasterKernels::CullMasks masks = mKernels.ClassifyScreenTriangles(screenX, screenY, lanes, static_cast<float>(mWidth), static_cast<float>(mHeight));
+                masks.Front &= tested;
+                masks.Back &= tested;
+                masks.OffScreen &= tested;
+                uint32_t outOfRange = 0;
+                if(mFixedPoint)
+                {
+                    outOfRange = SnappedWinding(masks, [&](int lane, int64_t X[3], int64_t Y[3])
+                    {
+                        for(int k = 0; k < 3; ++k)
+                        {
+                            if(!SnapPixel(screenX[lane * 3 + k], screenY[lane * 3 + k], X[k], Y[k]))
+                            {
+                                return false;
+                            }
+                        }
+                        return true;
+                    });
+                }
+                stats.TrianglesSubmitted += RasterKernels::PopCount(tested);
+                for(uint32_t keep = KeptLanes(masks, tested, outOfRange, stats); keep; keep &= keep - 1)
+                {
+                    int lane = RasterKernels::CountTrailingZeros(keep);
+                    *out++ = static_cast<uint32_t>(group + lane) << 1 | ((masks.Back >> lane) & 1);
+                }
+            }
+            return static_cast<int>(out - scratch.VisibleIndices.data());
+        }
+
+        constexpr inline static int ClipPlanes = RasterKernels::ClipPlanes;
+        constexpr inline static int MaxClipVertices = 3 + ClipPlanes; // every plane adds at most one vertex
+
+        // Coefficients of the clip planes in the order of their RasterKernels outcode bits, the
+        // guard band planes sit GuardBand pixels from the screen center, as far as the fixed-point
+        // snap goes
+        void ClipPlaneEquations(glm::vec4 planes[ClipPlanes]) const
+        {
+            float guardX = 2.0f * GuardBand / mWidth;
+            float guardY = 2.0f * GuardBand / mHeight;
+            planes[0] = glm::vec4(1, 0, 0, 1);
+            planes[1] = glm::vec4(-1, 0, 0, 1);
+            planes[2] = glm::vec4(0, 1, 0, 1);
+            planes[3] = glm::vec4(0, -1, 0, 1);
+            planes[4] = glm::vec4(0, 0, 1, 1);
+            planes[5] = glm::vec4(0, 0, -1, 1);
+            planes[6] = glm::vec4(1, 0, 0, guardX);
+            planes[7] = glm::vec4(-1, 0, 0, guardX);
+            planes[8] = glm::vec4(0, 1, 0, guardY);
+            planes[9] = glm::vec4(0, -1, 0, guardY);
+        }
+
+        // Planes ClipTriangles cuts triangles at, the others only reject. The fixed-point setup
+        // cannot snap vertices past the guard band, so it always cuts there.
+        uint32_t ClipCut() const
+        {
+            uint32_t guard = RasterKernels::GuardLeft | RasterKernels::GuardRight | RasterKernels::GuardBottom | RasterKernels::GuardTop;
+            return RasterKernels::ClipNear | (mClipGuardBand || mFixedPoint ? guard : 0);
+        }
+
+        static float PlaneDistance(const glm::vec4 &plane, const glm::vec4 &c)
+        {
+            return plane.x * c.x + plane.y * c.y + plane.z * c.z + plane.w * c.w;
+        }
+
+        // Puts a cut vertex exactly on its plane. The interpolation rounds relative to the far
+        // vertex, which for a vertex way past the guard band is many pixels, more than the
+        // fixed-point snap lets through.
+        static glm::vec4 OnPlane(const glm::vec4 &plane, glm::vec4 c)
+        {
+            for(int axis = 0; axis < 3; ++axis)
+            {
+                if(plane[axis] != 0.0f)
+                {
+                    c[axis] = -plane[axis] * plane.w * c.w; // plane[axis] is +-1
+                }
+            }
+            return c;
+        }
+
+        // Transforms `count` triangles to clip space and appends what is left of them after clipping
+        // as NDC triangles, to `whole` if they need no cut and to `pieces` otherwise. Triangles
+        // entirely outside one frustum plane are dropped, the others are only cut where the
+        // rasterizer cannot take them: at the near plane, where w goes to 0, and with
+        // mClipGuardBand or mFixedPoint at the guard band. The other frustum planes are left to the
+        // culling stage and the clamped traversal. A clipped triangle becomes a fan with the
+        // winding of the original. Dropped and cut triangles are counted in stats here, the whole
+        // ones are left to the culling.
+        void ClipTriangles(const glm::vec4 *positions, int count, const glm::mat4 &mvp, std::vector<glm::vec3> &whole,
+                           std::vector<glm::vec3> &pieces, TraversalStats &stats) const
+        {
+            glm::vec4 planes[ClipPlanes];
+            ClipPlaneEquations(planes);
+            uint32_t cut = ClipCut();
+            for(int i = 0; i < count; ++i)
+            {
+                glm::vec4 c[3];
+                uint32_t outside[3] = {};
+                for(int k = 0; k < 3; ++k)
+                {
+                    c[k] = mvp * positions[i * 3 + k];
+                    for(int p = 0; p < ClipPlanes; ++p)
+                    {
+                        outside[k] |= static_cast<uint32_t>(!(PlaneDistance(planes[p], c[k]) >= 0)) << p; // NaN is outside
+                    }
+                }
+                if(outside[0] & outside[1] & outside[2])
+                {
+                    stats.TrianglesSubmitted++;
+                    stats.TrianglesOffScreen++;
+                    continue;
+                }
+                if(!((outside[0] | outside[1] | outside[2]) & cut))
+                {
+                    for(int k = 0; k < 3; ++k)
+                    {
+                        whole.emplace_back(c[k].x / c[k].w, c[k].y / c[k].w, c[k].z / c[k].w);
+                    }
+                    continue;
+                }
+                stats.TrianglesSubmitted++;
+                CutTriangle(c, (outside[0] | outside[1] | outside[2]) & cut, planes, pieces);
+            }
+        }
+
+        // Sutherland-Hodgman against the planes of planesHit, one at a time, the rest of the
+        // triangle is appended to pieces in NDC as a fan with the winding of the original
+        static void CutTriangle(const glm::vec4 c[3], uint32_t planesHit, const glm::vec4 planes[ClipPlanes], std::vector<glm::vec3> &pieces)
+        {
+            glm::vec4 polygon[MaxClipVertices], next[MaxClipVertices];
+            int vertices = 3;
+            std::copy(c, c + 3, polygon);
+            for(int p = 0; p < ClipPlanes && vertices >= 3; ++p)
+            {
+                if(!((planesHit >> p) & 1))
+                {
+                    continue;
+                }
+                int kept = 0;
+                for(int k = 0; k < vertices; ++k)
+                {
+                    const glm::vec4 &a = polygon[k];
+                    const glm::vec4 &b = polygon[(k + 1) % vertices];
+                    float da = PlaneDistance(planes[p], a);
+                    float db = PlaneDistance(planes[p], b);
+                    if(da >= 0)
+                    {
+                        next[kept++] = a;
+                    }
+                    if((da >= 0) != (db >= 0))
+                    {
+                        float t = da / (da - db);
+                        next[kept++] = OnPlane(planes[p], a + (b - a) * t);
+                    }
+                }
+                std::copy(next, next + kept, polygon);
+                vertices = kept;
+            }
+            for(int k = 1; k + 1 < vertices; ++k)
+            {
+                for(const glm::vec4 *v : { &polygon[0], &polygon[k], &polygon[k + 1] })
+                {
+                    pieces.emplace_back(v->x / v->w, v->y / v->w, v->z / v->w);
+                }
+            }
+        }
+
+        // NDC counterpart of the guard band cut for the fixed-point RasterizePrototype3: with w = 1
+        // the guard band planes are the same in NDC. Returns false when no vertex is past the guard
+        // band and the vertices can be rasterized as they are. Otherwise mClipped gets the whole
+        // triangles in submission order followed by the pieces of the cut ones, and `whole` their
+        // count. Triangles with a NaN vertex stay whole and are left to the culling.
+        bool CutAtGuardBand(const std::vector<glm::vec3> &vertices, int &whole)
+        {
+            glm::vec4 planes[ClipPlanes];
+            ClipPlaneEquations(planes);
+            uint32_t guard = RasterKernels::GuardLeft | RasterKernels::GuardRight | RasterKernels::GuardBottom | RasterKernels::GuardTop;
+            auto outside = [&](const glm::vec3 &v)
+            {
+                uint32_t code = 0;
+                for(int p = 0; p < ClipPlanes; ++p)
+                {
+                    if((guard >> p) & 1)
+                    {
+                        code |= static_cast<uint32_t>(PlaneDistance(planes[p], glm::vec4(v, 1.0f)) < 0) << p;
+                    }
+                }
+                return code;
+            };
+            int triangles = static_cast<int>(vertices.size() / 3);
+            int first = 0;
+            while(first < triangles && !(outside(vertices[first * 3]) | outside(vertices[first * 3 + 1]) | outside(vertices[first * 3 + 2])))
+            {
+                ++first;
+            }
+            if(first == triangles)
+            {
+                return false;
+            }
+            mClipped.assign(vertices.begin(), vertices.begin() + first * 3);
+            mScratch.ClipPieces.clear();
+            for(int i = first; i < triangles; ++i)
+            {
+                glm::vec4 c[3];
+                uint32_t codes[3];
+                for(int k = 0; k < 3; ++k)
+                {
+                    c[k] = glm::vec4(vertices[i * 3 + k], 1.0f);
+                    codes[k] = outside(vertices[i * 3 + k]);
+                }
+                if(!(codes[0] | codes[1] | codes[2]))
+                {
+                    mClipped.insert(mClipped.end(), &vertices[i * 3], &vertices[i * 3] + 3);
+                    continue;
+                }
+                mScratch.Stats.TrianglesSubmitted++;
+                if(codes[0] & codes[1] & codes[2])
+                {
+                    mScratch.Stats.TrianglesOffScreen++;
+                    continue;
+                }
+                CutTriangle(c, codes[0] | codes[1] | codes[2], planes, mScratch.ClipPieces);
+            }
+            whole = static_cast<int>(mClipped.size() / 3);
+            mClipped.insert(mClipped.end(), mScratch.ClipPieces.begin(), mScratch.ClipPieces.end());
+            return true;
+        }
+
+        // Culling stage in front of the setup. Copies the triangles of [vertices, vertices + count * 3)
+        // that are neither degenerate, off screen nor of the culled winding to scratch.Visible, in
+        // submission order, and returns how many there are. With mFixedPoint, triangles with a vertex
+        // the snap cannot take are dropped as well. Back faces that are kept get their
+        // last two vertices swapped, which makes them front faces for the setup. The kernels
+        // classify CullLanes triangles at a time and the survivors are picked from the lane masks.
+        // The fixed-point setup decides the winding again on the snapped vertices, in integers, so
+        // the float area never disagrees with the edges it actually sets up. Only a triangle that
+        // is already degenerate in float can be dropped without that check. The first `counted`
+        // triangles go to the stats, the others are clip pieces whose triangle is counted already.
+        int CullTriangles(const glm::vec3 *vertices, int count, int counted, TileScratch &scratch) const
+        {
+            static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "the cull kernels read packed x, y, z vertices");
+            if(scratch.Visible.size() < static_cast<size_t>(count) * 3)
+            {
+                scratch.Visible.resize(static_cast<size_t>(count) * 3);
+            }
+            glm::vec3 *out = scratch.Visible.data();
+            TraversalStats &stats = scratch.Stats;
+            TraversalStats uncounted;
+            stats.TrianglesSubmitted += std::clamp(counted, 0, count);
+            for(int first = 0; first < count; first += RasterKernels::CullLanes)
+            {
+                int lanes = std::min(RasterKernels::CullLanes, count - first);
+                const glm::vec3 *v = &vertices[first * 3];
+                RasterKernels::CullMasks masks = mKernels.ClassifyTriangles(&v[0].x, lanes, static_cast<float>(mWidth), static_cast<float>(mHeight));
+                uint32_t outOfRange = 0;
+                if(mFixedPoint)
+                {
+                    outOfRange = SnappedWinding(masks, [&](int lane, int64_t X[3], int64_t Y[3])
+                    {
+                        for(int k = 0; k < 3; ++k)
+                        {
+                            if(!SnapVertex(v[lane * 3 + k], X[k], Y[k]))
+                            {
+                                return false;
+                            }
+                        }
+                        return true;
+                    });
+                }
+                uint32_t tested = (1u << lanes) - 1;
+                uint32_t countedLanes = (1u << std::clamp(counted - first, 0, lanes)) - 1;
+                uint32_t keep = KeptLanes(masks, countedLanes, outOfRange, stats) | KeptLanes(masks, tested & ~countedLanes, outOfRange, uncounted);
+                for(; keep; keep &= keep - 1)
+                {
+                    int lane = RasterKernels::CountTrailingZeros(keep);
+                    const glm::vec3 *t = &v[lane * 3];
+                    bool flip = (masks.Back >> lane) & 1;
+                    out[0] = t[0];
+                    out[1] = t[flip ? 2 : 1];
+                    out[2] = t[flip ? 1 : 2];
+                    out += 3;
+                }
+            }
+            return static_cast<int>((out - scratch.Visible.data()) / 3);
+        }
+
+        // Fixed-point setup: decides the winding of the lanes again from the snapped vertices given
+        // by snap(lane, X, Y), in integers. Only lanes with a non-zero float area, NaN vertices
+        // cannot be snapped. Lanes snap() refuses keep their float winding and are returned.
+        template <typename Snap>
+        static uint32_t SnappedWinding(RasterKernels::CullMasks &masks, Snap &&snap)
+        {
+            uint32_t outOfRange = 0;
+            for(uint32_t bits = masks.Front | masks.Back; bits; bits &= bits - 1)
+            {
+                int lane = RasterKernels::CountTrailingZeros(bits);
+                int64_t X[3], Y[3];
+                if(!snap(lane, X, Y))
+                {
+                    outOfRange |= 1u << lane;
+                    continue;
+                }
+                int64_t area = (X[1] - X[0]) * (Y[2] - Y[0]) - (X[2] - X[0]) * (Y[1] - Y[0]);
+                masks.Front = (masks.Front & ~(1u << lane)) | static_cast<uint32_t>(area > 0) << lane;
+                masks.Back = (masks.Back & ~(1u << lane)) | static_cast<uint32_t>(area < 0) << lane;
+            }
+            return outOfRange;
+        }
+
+        // Lanes of `tested` that are neither degenerate, off screen, out of the snap range nor of
+        // the culled winding, the others are counted in stats
+        uint32_t KeptLanes(const RasterKernels::CullMasks &masks, uint32_t tested, uint32_t outOfRange, TraversalStats &stats) const
+        {
+            uint32_t degenerate = tested & ~(masks.Front | masks.Back);
+            uint32_t offScreen = masks.OffScreen & tested & ~degenerate;
+            uint32_t unsnapped = outOfRange & tested & ~(degenerate | offScreen);
+            uint32_t faceCulled = (mCullMode == CullMode::Back ? masks.Back : mCullMode == CullMode::Front ? masks.Front : 0) & tested & ~(offScreen | unsnapped);
+            stats.TrianglesDegenerate += RasterKernels::PopCount(degenerate);
+            stats.TrianglesOffScreen += RasterKernels::PopCount(offScreen);
+            stats.TrianglesOutOfRange += RasterKernels::PopCount(unsnapped);
+            stats.TrianglesFaceCulled += RasterKernels::PopCount(faceCulled);
+            return tested & ~(degenerate | offScreen | unsnapped | faceCulled);
+        }
+
+        // Sets up `count` consecutive triangles given in NDC and calls visit(tri, index) for each one
+        // the setup accepts, see SetupBatch
+        template <typename TileRowT, typename Visit>
+        void SetupTriangles(const glm::vec3 *vertices, int count, TileScratch &scratch, Visit &&visit) const
+        {
+            SetupBatch<TileRowT>(count, scratch,
+                [&](int i, float x[3], float y[3])
+                {
+                    for(int k = 0; k < 3; ++k)
+                    {
+                        x[k] = (vertices[i * 3 + k].x + 1.0f) * 0.5f * static_cast<float>(mWidth);
+                        y[k] = (vertices[i * 3 + k].y + 1.0f) * 0.5f * static_cast<float>(mHeight);
+                    }
+                },
+                [&](int i, int64_t X[3], int64_t Y[3])
+                {
+                    for(int k = 0; k < 3; ++k)
+                    {
+                        if(!SnapVertex(vertices[i * 3 + k], X[k], Y[k]))
+                        {
+                            return false;
+                        }
+                    }
+                    return true;
+                }, visit);
+        }
+
+        // Sets up triangles [0, count) and calls visit(tri, index) for each one the setup accepts.
+        // The float setup reads triangle i in pixels from pixels(i, x, y) and runs SetupLanes
+        // triangles at a time through the batched kernel, the fixed-point one reads it in subpixels
+        // from snapped(i, X, Y), false if it cannot be snapped, and goes triangle by triangle.
+        template <typename TileRowT, typename Pixels, typename Snapped, typename Visit>
+        void SetupBatch(int count, TileScratch &scratch, Pixels &&pixels, Snapped &&snapped, Visit &&visit) const
+        {
+            TriangleTiles<TileRowT> tri;
+            if constexpr(std::is_same_v<TileRowT, RasterKernels::TileRowFixed<Mask>>)
+            {
+                for(int i = 0; i < count; ++i)
+                {
+                    int64_t X[3], Y[3];
+                    scratch.RowOffsetsFixed.clear();
+                    if(snapped(i, X, Y) && SetupSnappedTriangle(X, Y, tri, scratch.RowOffsetsFixed))
+                    {
+                        tri.RowOffsets = scratch.RowOffsetsFixed.data();
+                        visit(tri, i);
+                    }
+                }
+            }
+            else
+            {
+                RasterKernels::TriangleBatch batch;
+                for(int first = 0; first < count; first += RasterKernels::SetupLanes)
+                {
+                    int lanes = std::min(RasterKernels::SetupLanes, count - first);
+                    for(int lane = 0; lane < RasterKernels::SetupLanes; ++lane)
+                    {
+                        // Unused lanes repeat the last triangle, the SIMD kernels compute them anyway
+                        float x[3], y[3];
+                        pixels(first + std::min(lane, lanes - 1), x, y);
+                        for(int k = 0; k < 3; ++k)
+                        {
+                            batch.X[k][lane] = x[k];
+                            batch.Y[k][lane] = y[k];
+                        }
+                    }
+                    mKernels.SetupTriangles(batch, lanes, static_cast<float>(mWidth), static_cast<float>(mHeight), static_cast<float>(QuantizationResolution));
+                    for(int lane = 0; lane < lanes; ++lane)
+                    {
+                        scratch.RowOffsets.clear();
+                        if(FinishSetup(batch, lane, tri, scratch.RowOffsets))
+                        {
+                            tri.RowOffsets = scratch.RowOffsets.data();
+                            visit(tri, first + lane);
+                        }
+                    }
+                }
+            }
+        }
+
+        // Float setup of one triangle given in NDC, see FinishSetup
+        bool SetupTriangle(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2,
+                           TriangleTiles<RasterKernels::TileRow<Mask>> &tri, std::vector<float> &rowOffsets) const
+        {
+            RasterKernels::TriangleBatch batch;
+            const glm::vec3 *v[3] = { &p0, &p1, &p2 };
+            for(int k = 0; k < 3; ++k)
+            {
+                batch.X[k][0] = (v[k]->x + 1.0f) * 0.5f * static_cast<float>(mWidth);
+                batch.Y[k][0] = (v[k]->y + 1.0f) * 0.5f * static_cast<float>(mHeight);
+            }
+            RasterKernels::SetupTrianglesScalar(batch, 1, static_cast<float>(mWidth), static_cast<float>(mHeight), static_cast<float>(QuantizationResolution));
+            return FinishSetup(batch, 0, tri, rowOffsets);
+        }
+
+        // Per-triangle part of the float setup, from the lines, bounds and angle buckets of the
+        // batched setup kernel. The 3 offset indices per tile row are appended to rowOffsets, the
+        // caller points tri.RowOffsets at them once they stop moving.
+        bool FinishSetup(const RasterKernels::TriangleBatch &batch, int lane,
+                         TriangleTiles<RasterKernels::TileRow<Mask>> &tri, std::vector<float> &rowOffsets) const
+        {
+            glm::vec3 line0 = glm::vec3(batch.LineX[0][lane], batch.LineY[0][lane], batch.LineZ[0][lane]);
+            glm::vec3 line1 = glm::vec3(batch.LineX[1][lane], batch.LineY[1][lane], batch.LineZ[1][lane]);
+            glm::vec3 line2 = glm::vec3(batch.LineX[2][lane], batch.LineY[2][lane], batch.LineZ[2][lane]);
+            // The pixel bounds are clamped to the screen by the kernel
+            int minX = FloorDiv(batch.MinX[lane], GridSize);
+            int maxX = CeilDiv(batch.MaxX[lane], GridSize);
+            int minY = FloorDiv(batch.MinY[lane], GridSize);
+            int maxY = CeilDiv(batch.MaxY[lane], GridSize);
+
+
+            float deltax0 = line0.x * GridSize;
+            float deltay0 = line0.y * GridSize;
+            float deltax1 = line1.x * GridSize;
+            float deltay1 = line1.y * GridSize;
+            float deltax2 = line2.x * GridSize;
+            float deltay2 = line2.y * GridSize;
+
+            float Offset0 = line0.z + deltay0 * minY;
+            float Offset1 = line1.z + deltay1 * minY;
+            float Offset2 = line2.z + deltay2 * minY;
+
+            uint8_t symmetry0, symmetry1, symmetry2;
+            uint32_t IdxPre0 = TableIndex(OctantAngle(batch.Octant[0][lane], batch.Step[0][lane], symmetry0), 0);
+            uint32_t IdxPre1 = TableIndex(OctantAngle(batch.Octant[1][lane], batch.Step[1][lane], symmetry1), 0);
+            uint32_t IdxPre2 = TableIndex(OctantAngle(batch.Octant[2][lane], batch.Step[2][lane], symmetry2), 0);
+
+            // Offsets are remapped to offset-index space once per row, so a tile only needs a multiply-add
+            tri.MinX = minX;
+            tri.MaxX = maxX;
+            tri.MinY = minY;
+            tri.MaxY = maxY;
+            tri.Row.Masks[0] = BitMaskTable + IdxPre0;
+            tri.Row.Masks[1] = BitMaskTable + IdxPre1;
+            tri.Row.Masks[2] = BitMaskTable + IdxPre2;
+            tri.Row.DeltaX[0] = deltax0 / GridRange * OffsetSample;
+            tri.Row.DeltaX[1] = deltax1 / GridRange * OffsetSample;
+            tri.Row.DeltaX[2] = deltax2 / GridRange * OffsetSample;
+            tri.Row.Symmetry[0] = symmetry0;
+            tri.Row.Symmetry[1] = symmetry1;
+            tri.Row.Symmetry[2] = symmetry2;
+            float shift0 = SymmetryShift(symmetry0, tri.Row.DeltaX[0], deltay0 / GridRange * OffsetSample);
+            float shift1 = SymmetryShift(symmetry1, tri.Row.DeltaX[1], deltay1 / GridRange * OffsetSample);
+            float shift2 = SymmetryShift(symmetry2, tri.Row.DeltaX[2], deltay2 / GridRange * OffsetSample);
+            tri.FirstNonEmpty[0] = FirstNonEmptyOffset[IdxPre0 / OffsetSample];
+            tri.FirstNonEmpty[1] = FirstNonEmptyOffset[IdxPre1 / OffsetSample];
+            tri.FirstNonEmpty[2] = FirstNonEmptyOffset[IdxPre2 / OffsetSample];
+            tri.FirstFull[0] = FirstFullOffset[IdxPre0 / OffsetSample];
+            tri.FirstFull[1] = FirstFullOffset[IdxPre1 / OffsetSample];
+            tri.FirstFull[2] = FirstFullOffset[IdxPre2 / OffsetSample];
+
+            // Offset index k of the tables is the edge moved (k / OffsetSample - 0.5) * GridRange pixels
+            // past the tile corner, see RasterTables::Generate, so a corner at distance d maps to
+            // (d / GridRange + 0.5) * OffsetSample, which the kernels truncate toward the inside.
+            size_t rowBase = rowOffsets.size();
+            rowOffsets.resize(rowBase + std::max(maxY - minY, 0) * 3);
+            for(int y = minY; y < maxY; ++y)
+            {
+                float *rowOffset = &rowOffsets[rowBase + (y - minY) * 3];
+                rowOffset[0] = (Offset0 / GridRange + 0.5f) * OffsetSample + shift0;
+                rowOffset[1] = (Offset1 / GridRange + 0.5f) * OffsetSample + shift1;
+                rowOffset[2] = (Offset2 / GridRange + 0.5f) * OffsetSample + shift2;
+                Offset0 += deltay0;
+                Offset1 += deltay1;
+                Offset2 += deltay2;
+            }
+            tri.RowOffsets = nullptr;
+            return true;
+        }
+
+        // (ndc + 1) * 0.5 * size in subpixels, the vertex snapping of the fixed-point setup. False
+        // for NaN or a vertex past the guard band, which the integer setup cannot take.
+        bool SnapVertex(const glm::vec3 &v, int64_t &x, int64_t &y) const
+        {
+            const int64_t halfWidth = static_cast<int64_t>(mWidth) << (SubpixelBits - 1);
+            const int64_t halfHeight = static_cast<int64_t>(mHeight) << (SubpixelBits - 1);
+            float centeredX = v.x * static_cast<float>(halfWidth);
+            float centeredY = v.y * static_cast<float>(halfHeight);
+            if(!InSnapRange(centeredX) || !InSnapRange(centeredY))
+            {
+                return false;
+            }
+            x = std::llround(centeredX) + halfWidth;
+            y = std::llround(centeredY) + halfHeight;
+            return true;
+        }
+
+        // Same snapping for a vertex already in pixels, as TransformVertices writes them. The
+        // multiply by the subpixel count is exact, the centering subtract rounds once.
+        bool SnapPixel(float pixelX, float pixelY, int64_t &x, int64_t &y) const
+        {
+            const int64_t halfWidth = static_cast<int64_t>(mWidth) << (SubpixelBits - 1);
+            const int64_t halfHeight = static_cast<int64_t>(mHeight) << (SubpixelBits - 1);
+            float centeredX = pixelX * (1 << SubpixelBits) - static_cast<float>(halfWidth);
+            float centeredY = pixelY * (1 << SubpixelBits) - static_cast<float>(halfHeight);
+            if(!InSnapRange(centeredX) || !InSnapRange(centeredY))
+            {
+                return false;
+            }
+            x = std::llround(centeredX) + halfWidth;
+            y = std::llround(centeredY) + halfHeight;
+            return true;
+        }
+
+        // Subpixels from the screen center, up to the guard band plus a pixel for the rounding of
+        // vertices clipped at the guard band planes. False for NaN.
+        static bool InSnapRange(float centered)
+        {
+            constexpr float SubpixelLimit = static_cast<float>(int64_t(GuardBand + 1) << SubpixelBits);
+            return std::abs(centered) <= SubpixelLimit;
+        }
+
+        // Integer counterpart of the float setup, takes NDC vertices. They are snapped to
+        // 1/2^SubpixelBits pixel with a single float multiply each (nothing a compiler can
+        // reassociate), edge normals and offsets are fixed-point with FixedShift fractional bits and
+        // rows/tiles are stepped by integer adds. The output is the same whatever the compiler, flags
+        // or machine. Returns false for coincident vertices or a vertex past the guard band.
+        bool SetupTriangle(const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2,
+                           TriangleTiles<RasterKernels::TileRowFixed<Mask>> &tri, std::vector<int64_t> &rowOffsets) const
+        {
+            int64_t X[3], Y[3];
+            if(!SnapVertex(v0, X[0], Y[0]) || !SnapVertex(v1, X[1], Y[1]) || !SnapVertex(v2, X[2], Y[2]))
+            {
+                return false;
+            }
+            return SetupSnappedTriangle(X, Y, tri, rowOffsets);
+        }
+
+        // Fixed-point setup from vertices already snapped to subpixels
+        bool SetupSnappedTriangle(const int64_t X[3], const int64_t Y[3],
+                                  TriangleTiles<RasterKernels::TileRowFixed<Mask>> &tri, std::vector<int64_t> &rowOffsets) const
+        {
+            constexpr int32_t GridRangeFixed = static_cast<int32_t>(GridRange);
+            static_assert(GridRange == GridRangeFixed, "fixed-point setup needs an integral GridRange");
+            constexpr int64_t One = int64_t(1) << RasterKernels::FixedShift;
+
+            // Bounding Box, floor/ceil of the snapped coordinates clamped to the screen
+            int minX = static_cast<int>(std::clamp<int64_t>(std::min({X[0], X[1], X[2]}) >> SubpixelBits, 0, mWidth));
+            int maxX = static_cast<int>(std::clamp<int64_t>((std::max({X[0], X[1], X[2]}) + (1 << SubpixelBits) - 1) >> SubpixelBits, 0, mWidth));
+            int minY = static_cast<int>(std::clamp<int64_t>(std::min({Y[0], Y[1], Y[2]}) >> SubpixelBits, 0, mHeight));
+            int maxY = static_cast<int>(std::clamp<int64_t>((std::max({Y[0], Y[1], Y[2]}) + (1 << SubpixelBits) - 1) >> SubpixelBits, 0, mHeight));
+
+            minY = FloorDiv(minY, GridSize);
+            maxY = CeilDiv(maxY, GridSize);
+            minX = FloorDiv(minX, GridSize);
+            maxX = CeilDiv(maxX, GridSize);
+
+            tri.MinX = minX;
+            tri.MaxX = maxX;
+            tri.MinY = minY;
+            tri.MaxY = maxY;
+            int64_t offset[3];
+            int64_t deltay[3];
+            for(int e = 0; e < 3; ++e)
+            {
+                int a = e;
+                int b = (e + 1) % 3;
+                int64_t ex = X[a] - X[b];
+                int64_t ey = Y[a] - Y[b];
+                int64_t length = IntegerSqrt(ex * ex + ey * ey);
+                if(length == 0)
+                {
+                    return false; // coincident vertices
+                }
+                int64_t nx = ey * One / length;
+                int64_t ny = -ex * One / length;
+
+                // Distance of the corner of tile (0, minY) to the edge, then remapped to offset-index space
+                // as in FinishSetup
+                int64_t cornerX = -X[a];
+                int64_t cornerY = static_cast<int64_t>(minY) * GridSize * (1 << SubpixelBits) - Y[a];
+                int64_t distance = (nx * cornerX + ny * cornerY) >> SubpixelBits;
+                offset[e] = distance * OffsetSample / GridRangeFixed + (int64_t(OffsetSample / 2) << RasterKernels::FixedShift);
+                deltay[e] = ny * GridSize * OffsetSample / GridRangeFixed;
+                tri.Row.DeltaX[e] = static_cast<int32_t>(nx * GridSize * OffsetSample / GridRangeFixed);
+
+                uint8_t symmetry;
+                uint32_t IdxPre = TableIndex(AngleIndex(nx, ny, symmetry), 0);
+                tri.Row.Masks[e] = BitMaskTable + IdxPre;
+                tri.Row.Symmetry[e] = symmetry;
+                offset[e] += SymmetryShift<int64_t>(symmetry, tri.Row.DeltaX[e], deltay[e]);
+                tri.FirstNonEmpty[e] = FirstNonEmptyOffset[IdxPre / OffsetSample];
+                tri.FirstFull[e] = FirstFullOffset[IdxPre / OffsetSample];
+            }
+
+            size_t rowBase = rowOffsets.size();
+            rowOffsets.resize(rowBase + std::max(maxY - minY, 0) * 3);
+            for(int y = minY; y < maxY; ++y)
+            {
+                int64_t *rowOffset = &rowOffsets[rowBase + (y - minY) * 3];
+                for(int e = 0; e < 3; ++e)
+                {
+                    rowOffset[e] = offset[e];
+                    offset[e] += deltay[e];
+                }
+            }
+            tri.RowOffsets = nullptr;
+            return true;
+        }
+
+        // Classifies tiles [x0, x1) x [y0, y1). The offset index of an edge is monotone in x and in y,
+        // so its extremes over the block are at the corner tiles, and since the masks only grow with
+        // the offset index the answer is exactly what the per-tile lookups would produce.
+        template <typename TileRowT>
+        BlockCoverage ClassifyBlock(const TriangleTiles<TileRowT> &tri, int x0, int x1, int y0, int y1) const
+        {
+            const auto *top = tri.RowOffsets + (y0 - tri.MinY) * 3;
+            const auto *bottom = tri.RowOffsets + (y1 - 1 - tri.MinY) * 3;
+            bool full = true;
+            for(int e = 0; e < 3; ++e)
+            {
+                auto deltaX = tri.Row.DeltaX[e];
+                int k0 = OffsetIndex(top[e], deltaX, x0);
+                int k1 = OffsetIndex(top[e], deltaX, x1 - 1);
+                int k2 = OffsetIndex(bottom[e], deltaX, x0);
+                int k3 = OffsetIndex(bottom[e], deltaX, x1 - 1);
+                if(std::max({k0, k1, k2, k3}) < tri.FirstNonEmpty[e])
+                {
+                    return BlockCoverage::Empty;
+                }
+                full = full && std::min({k0, k1, k2, k3}) >= tri.FirstFull[e];
+            }
+            return full ? BlockCoverage::Full : BlockCoverage::Partial;
+        }
+
+        // Narrows [first, last) of tile row y to the tiles where every edge reaches its FirstNonEmpty
+        // offset index. The bound is estimated from the edge equation and then snapped with the same
+        // arithmetic as the kernels, so no tile with a non-empty mask is ever dropped.
+        template <typename TileRowT>
+        void ComputeRowSpan(const TriangleTiles<TileRowT> &tri, int y, int &first, int &last) const
+        {
+            const auto *rowOffset = tri.RowOffsets + (y - tri.MinY) * 3;
+            for(int e = 0; e < 3 && first < last; ++e)
+            {
+                auto offset = rowOffset[e];
+                auto deltaX = tri.Row.DeltaX[e];
+                int threshold = tri.FirstNonEmpty[e];
+                auto reaches = [&](int x) { return OffsetIndex(offset, deltaX, x) >= threshold; };
+                if(deltaX == 0)
+                {
+                    if(!reaches(first))
+                    {
+                        last = first;
+                    }
+                    continue;
+                }
+
+                int x = SpanEstimate(offset, deltaX, threshold, first, last);
+                while(x > first && (deltaX > 0) == reaches(x - 1))
+                {
+                    --x;
+                }
+                while(x < last && (deltaX > 0) != reaches(x))
+                {
+                    ++x;
+                }
+                if(deltaX > 0)
+                {
+                    first = x;
+                }
+                else
+                {
+                    last = x;
+                }
+            }
+            last = std::max(first, last);
+        }
+
+        template <typename TileRowT>
+        void RasterizeTileRow(TriangleTiles<TileRowT> &tri, TileScratch &scratch, int y, int x0, int x1)
+        {
+            if(tri.RowSpans)
+            {
+                const int *span = tri.RowSpans + (y - tri.MinY) * 2;
+                int first = std::max(x0, span[0]);
+                int last = std::min(x1, span[1]);
+                scratch.Stats.TilesSkipped += (x1 - x0) - std::max(last - first, 0);
+                x0 = first;
+                x1 = last;
+            }
+            if(x1 <= x0)
+            {
+                return;
+            }
+            scratch.Stats.TilesLookedUp += x1 - x0;
+
+            const auto *rowOffset = tri.RowOffsets + (y - tri.MinY) * 3;
+            tri.Row.Offset[0] = rowOffset[0];
+            tri.Row.Offset[1] = rowOffset[1];
+            tri.Row.Offset[2] = rowOffset[2];
+            Mask tileMasks[TileBatch];
+            for(int batchX = x0; batchX < x1; batchX += TileBatch)
+            {
+                int count = std::min(TileBatch, x1 - batchX);
+                CoverageRow(tri.Row, batchX, count, tileMasks);
+                StoreTiles(scratch, batchX, y, count, tileMasks);
+            }
+        }
+
+        // Rasterizes the tiles of tri inside clip and the screen, so StoreTiles only ever sees tiles
+        // of the grid. The triangle is taken by value since the traversal fills in its per-row
+        // fields and binned triangles are shared between threads.
+        template <typename TileRowT>
+        void TraverseTiles(TriangleTiles<TileRowT> tri, TileScratch &scratch, const TileRect &clip)
+        {
+            int minX = std::max({ tri.MinX, clip.X0, 0 });
+            int maxX = std::min({ tri.MaxX, clip.X1, mTilesX });
+            int minY = std::max({ tri.MinY, clip.Y0, 0 });
+            int maxY = std::min({ tri.MaxY, clip.Y1, mTilesY });
+            if(maxX <= minX || maxY <= minY)
+            {
+                return;
+            }
+            scratch.Stats.TilesInBounds += static_cast<uint64_t>(maxX - minX) * (maxY - minY);
+            tri.RowSpans = nullptr;
+            if(mRowSpans)
+            {
+                scratch.RowSpanBounds.resize((tri.MaxY - tri.MinY) * 2);
+                for(int y = minY; y < maxY; ++y)
+                {
+                    int *span = &scratch.RowSpanBounds[(y - tri.MinY) * 2];
+                    span[0] = minX;
+                    span[1] = maxX;
+                    ComputeRowSpan(tri, y, span[0], span[1]);
+                }
+                tri.RowSpans = scratch.RowSpanBounds.data();
+            }
+
+            if(!mHierarchicalTraversal)
+            {
+                for(int y = minY; y < maxY; ++y)
+                {
+                    RasterizeTileRow(tri, scratch, y, minX, maxX);
+                }
+                return;
+            }
+
+            Mask fullMasks[SuperTileSize];
+            std::fill(fullMasks, fullMasks + SuperTileSize, RasterKernels::FullMask<Mask>());
+            for(int sy = minY; sy < maxY; sy += SuperTileSize)
+            {
+                int sy1 = std::min(sy + SuperTileSize, maxY);
+                for(int sx = minX; sx < maxX; sx += SuperTileSize)
+                {
+                    int sx1 = std::min(sx + SuperTileSize, maxX);
+                    uint64_t tiles = static_cast<uint64_t>(sx1 - sx) * (sy1 - sy);
+                    switch(ClassifyBlock(tri, sx, sx1, sy, sy1))
+                    {
+                        case BlockCoverage::Empty:
+                            scratch.Stats.SuperTilesRejected++;
+                            scratch.Stats.TilesSkipped += tiles;
+                            break;
+                        case BlockCoverage::Full:
+                            scratch.Stats.SuperTilesAccepted++;
+                            scratch.Stats.TilesFilled += tiles;
+                            for(int y = sy; y < sy1; ++y)
+                            {
+                                StoreTiles(scratch, sx, y, sx1 - sx, fullMasks);
+                            }
+                            break;
+                        case BlockCoverage::Partial:
+                            scratch.Stats.SuperTilesPartial++;
+                            for(int y = sy; y < sy1; ++y)
+                            {
+                                RasterizeTileRow(tri, scratch, y, sx, sx1);
+                            }
+                            break;
+                    }
+                }
+            }
+        }
+
+        // Sort-middle mode of RasterizePrototype3. Jobs of BinBatch triangles are binned in parallel
+        // into the screen regions of mBinTiles^2 tiles they may cover, then bins are rasterized in
+        // parallel. A bin owns all of its tiles, so framebuffer writes need no synchronization, and
+        // walks the jobs in order, so triangles keep their submission order inside it. Jobs cull
+        // their triangles first and bins hold copies of the survivors, each bin redoes the setup
+        // since that is cheaper than reading stored setups back from memory, and the culling, setup
+        // and exact tile classification are the ones of the single-threaded path, so the result is
+        // the same.
+        template <typename TileRowT>
+        void RasterizeBinned(const std::vector<glm::vec3> &vertices, int counted)
+        {
+            using OffsetType = typename TileRowT::OffsetType;
+            int binsX = (mTilesX + mBinTiles - 1) / mBinTiles;
+            int binsY = (mTilesY + mBinTiles - 1) / mBinTiles;
+            int bins = binsX * binsY;
+            int triangles = static_cast<int>(vertices.size() / 3);
+            int jobs = (triangles + BinBatch - 1) / BinBatch;
+            if(static_cast<int>(mBinJobs.size()) < jobs)
+            {
+                mBinJobs.resize(jobs);
+            }
+
+            mPool->ParallelFor(jobs, [&](int job, int participant)
+            {
+                TileScratch &scratch = mWorkerScratch[participant];
+                std::vector<OffsetType> &rowOffsets = RowOffsetScratch<OffsetType>(scratch);
+                std::vector<std::vector<glm::vec3>> &jobBins = mBinJobs[job];
+                jobBins.resize(bins);
+                for(std::vector<glm::vec3> &bin : jobBins)
+                {
+                    bin.clear();
+                }
+
+                int first = job * BinBatch;
+                int visible = CullTriangles(&vertices[first * 3], std::min(BinBatch, triangles - first), counted - first, scratch);
+                for(int i = 0; i < visible; ++i)
+                {
+                    const glm::vec3 *v = &scratch.Visible[i * 3];
+                    int minX, maxX, minY, maxY;
+                    if(!ConservativeTileBounds(v, minX, maxX, minY, maxY))
+                    {
+                        continue;
+                    }
+                    // Triangles inside one bin go there without a setup, the others get the exact
+                    // bounds and per-bin rejection below
+                    TriangleTiles<TileRowT> tri;
+                    if(minX / mBinTiles != (maxX - 1) / mBinTiles || minY / mBinTiles != (maxY - 1) / mBinTiles)
+                    {
+                        rowOffsets.clear();
+                        if(!SetupTriangle(v[0], v[1], v[2], tri, rowOffsets))
+                        {
+                            continue;
+                        }
+                        tri.RowOffsets = rowOffsets.data();
+                        minX = std::max(tri.MinX, 0);
+                        maxX = std::min(tri.MaxX, mTilesX);
+                        minY = std::max(tri.MinY, 0);
+                        maxY = std::min(tri.MaxY, mTilesY);
+                        if(maxX <= minX || maxY <= minY)
+                        {
+                            continue;
+                        }
+                    }
+                    int bx0 = minX / mBinTiles;
+                    int bx1 = (maxX - 1) / mBinTiles;
+                    int by0 = minY / mBinTiles;
+                    int by1 = (maxY - 1) / mBinTiles;
+                    bool single = bx0 == bx1 && by0 == by1;
+                    for(int by = by0; by <= by1; ++by)
+                    {
+                        for(int bx = bx0; bx <= bx1; ++bx)
+                        {
+                            // Large triangles skip the bins their edges exclude entirely
+                            if(!single)
+                            {
+                                int x0 = std::max(minX, bx * mBinTiles);
+                                int x1 = std::min(maxX, (bx + 1) * mBinTiles);
+                                int y0 = std::max(minY, by * mBinTiles);
+                                int y1 = std::min(maxY, (by + 1) * mBinTiles);
+                                if(ClassifyBlock(tri, x0, x1, y0, y1) == BlockCoverage::Empty)
+                                {
+                                    continue;
+                                }
+                            }
+                            jobBins[by * binsX + bx].insert(jobBins[by * binsX + bx].end(), v, v + 3);
+                        }
+                    }
+                }
+            });
+
+            mPool->ParallelFor(bins, [&](int bin, int participant)
+            {
+                TileScratch &scratch = mWorkerScratch[participant];
+                int bx = bin % binsX;
+                int by = bin / binsX;
+                TileRect clip = { bx * mBinTiles, std::min((bx + 1) * mBinTiles, mTilesX),
+                                  by * mBinTiles, std::min((by + 1) * mBinTiles, mTilesY) };
+                for(int job = 0; job < jobs; ++job)
+                {
+                    const std::vector<glm::vec3> &binVertices = mBinJobs[job][bin];
+                    SetupTriangles<TileRowT>(binVertices.data(), static_cast<int>(binVertices.size() / 3), scratch,
+                                             [&](auto &tri, int) { TraverseTiles(tri, scratch, clip); });
+                }
+            });
+
+            MergeWorkerStats();
+        }
+
+        // Sort-last mode of RasterizePrototype3. Triangles are handed to the threads in small jobs
+        // with no binning, each job culls its own, and every tile mask is ORed atomically into a
+        // shared coverage word.
+        // Coverage is binary, so the result does not depend on the order and matches the
+        // single-threaded path. Triangles over mSplitTiles tiles would leave the other threads idle,
+        // so they are set aside and rasterized afterwards as strips of tile rows, one job per strip.
+        // The Linear and Tiled layouts go through a coverage buffer that is written to the
+        // framebuffer at the end, one tile row per job.
+        template <typename TileRowT>
+        void RasterizeSortLast(const std::vector<glm::vec3> &vertices, int counted)
+        {
+            using OffsetType = typename TileRowT::OffsetType;
+            Mask *coverage = BeginSharedCoverage();
+            auto rasterize = [&](TileScratch &scratch, const glm::vec3 *v, const TileRect &clip)
+            {
+                std::vector<OffsetType> &rowOffsets = RowOffsetScratch<OffsetType>(scratch);
+                TriangleTiles<TileRowT> tri;
+                rowOffsets.clear();
+                if(SetupTriangle(v[0], v[1], v[2], tri, rowOffsets))
+                {
+                    tri.RowOffsets = rowOffsets.data();
+                    TraverseTiles(tri, scratch, clip);
+                }
+            };
+
+            // A few jobs per thread, the scheduler steals from the ones that fall behind
+            int triangles = static_cast<int>(vertices.size() / 3);
+            int batch = std::max(1, triangles / (mPool->Participants() * 8));
+            int jobs = (triangles + batch - 1) / batch;
+            if(static_cast<int>(mLargeTriangles.size()) < jobs)
+            {
+                mLargeTriangles.resize(jobs);
+            }
+            mPool->ParallelFor(jobs, [&](int job, int participant)
+            {
+                TileScratch &scratch = mWorkerScratch[participant];
+                scratch.SharedCoverage = coverage;
+                mLargeTriangles[job].clear();
+                int first = job * batch;
+                int visible = CullTriangles(&vertices[first * 3], std::min(batch, triangles - first), counted - first, scratch);
+                // Runs of small triangles go through the batched setup
+                int run = 0;
+                auto flush = [&](int end)
+                {
+                    SetupTriangles<TileRowT>(&scratch.Visible[run * 3], end - run, scratch, [&](auto &tri, int) { TraverseTiles(tri, scratch, AllTiles); });
+                };
+                for(int i = 0; i < visible; ++i)
+                {
+                    const glm::vec3 *v = &scratch.Visible[i * 3];
+                    int minX, maxX, minY, maxY;
+                    if(ConservativeTileBounds(v, minX, maxX, minY, maxY) && static_cast<int64_t>(maxX - minX) * (maxY - minY) > mSplitTiles)
+                    {
+                        flush(i);
+                        run = i + 1;
+                        mLargeTriangles[job].insert(mLargeTriangles[job].end(), v, v + 3);
+                    }
+                }
+                flush(visible);
+                scratch.SharedCoverage = nullptr;
+            });
+
+            mSplitJobs.clear();
+            for(int job = 0; job < jobs; ++job)
+            {
+                for(size_t i = 0; i < mLargeTriangles[job].size(); i += 3)
+                {
+                    const glm::vec3 *v = &mLargeTriangles[job][i];
+                    int minX, maxX, minY, maxY;
+                    if(!ConservativeTileBounds(v, minX, maxX, minY, maxY))
+                    {
+                        continue; // set aside only with bounds on screen
+                    }
+                    int rows = std::max(1, mSplitTiles / (maxX - minX));
+                    for(int y = minY; y < maxY; y += rows)
+                    {
+                        mSplitJobs.push_back({ v, y, std::min(y + rows, maxY) });
+                    }
+                }
+            }
+            mPool->ParallelFor(static_cast<int>(mSplitJobs.size()), [&](int job, int participant)
+            {
+                TileScratch &scratch = mWorkerScratch[participant];
+                const SplitJob &split = mSplitJobs[job];
+                scratch.SharedCoverage = coverage;
+                rasterize(scratch, split.Triangle, TileRect{ INT_MIN, INT_MAX, split.Y0, split.Y1 });
+                scratch.SharedCoverage = nullptr;
+            });
+
+            ResolveSharedCoverage();
+            MergeWorkerStats();
+        }
+
+        // Coverage words the sort-last traversals OR into, the Linear and Tiled layouts get a
+        // cleared buffer that ResolveSharedCoverage writes out
+        Mask *BeginSharedCoverage()
+        {
+            if(mLayout == FrameBufferLayout::Coverage)
+            {
+                return CoverageBuffer.data();
+            }
+            mSortLastCoverage.assign(static_cast<size_t>(mTilesX) * mTilesY, Mask{});
+            return mSortLastCoverage.data();
+        }
+
+        // Writes the shared coverage to the framebuffer, one tile row per job
+        void ResolveSharedCoverage()
+        {
+            if(mLayout != FrameBufferLayout::Coverage)
+            {
+                mPool->ParallelFor(mTilesY, [&](int y, int)
+                {
+                    StoreTiles(0, y, mTilesX, &mSortLastCoverage[static_cast<size_t>(y) * mTilesX]);
+                });
+            }
+        }
+
+        void MergeWorkerStats()
+        {
+            for(TileScratch &scratch : mWorkerScratch)
+            {
+                mScratch.Stats += scratch.Stats;
+                scratch.Stats = {};
+            }
+        }
+
+        // On-screen tiles of a triangle given in NDC, a pixel wider on every side than the bounds of
+        // either setup so the fixed-point snapping stays inside. False if none are on screen.
+        bool ConservativeTileBounds(const glm::vec3 *v, int &minX, int &maxX, int &minY, int &maxY) const
+        {
+            float x0 = (std::min({v[0].x, v[1].x, v[2].x}) + 1.0f) * 0.5f * mWidth - 1.0f;
+            float x1 = (std::max({v[0].x, v[1].x, v[2].x}) + 1.0f) * 0.5f * mWidth + 1.0f;
+            float y0 = (std::min({v[0].y, v[1].y, v[2].y}) + 1.0f) * 0.5f * mHeight - 1.0f;
+            float y1 = (std::max({v[0].y, v[1].y, v[2].y}) + 1.0f) * 0.5f * mHeight + 1.0f;
+            if(!(x1 > 0 && y1 > 0 && x0 < mWidth && y0 < mHeight))
+            {
+                return false;
+            }
+            minX = static_cast<int>(std::max(x0, 0.0f)) / GridSize;
+            maxX = std::min(static_cast<int>(std::ceil(std::min(x1, (float)mWidth))) / GridSize + 1, mTilesX);
+            minY = static_cast<int>(std::max(y0, 0.0f)) / GridSize;
+            maxY = std::min(static_cast<int>(std::ceil(std::min(y1, (float)mHeight))) / GridSize + 1, mTilesY);
+            return true;
+        }
+
+        template <typename OffsetType>
+        static std::vector<OffsetType> &RowOffsetScratch(TileScratch &scratch)
+        {
+            if constexpr(std::is_same_v<OffsetType, float>)
+            {
+                return scratch.RowOffsets;
+            }
+            else
+            {
+                return scratch.RowOffsetsFixed;
+            }
+        }
+
+        void SetPixel(int pixelX, int pixelY)
+        {
+            size_t tileIdx = (pixelY / GridSize) * mTilesX + pixelX / GridSize;
+            int bitIdx = (pixelY % GridSize) * GridSize + pixelX % GridSize;
+            if(mLayout == FrameBufferLayout::Coverage)
+            {
+                RasterKernels::SetBit(CoverageBuffer[tileIdx], bitIdx);
+            }
+            else if(mLayout == FrameBufferLayout::Tiled)
+            {
+                FrameBuffer[tileIdx * GridSize * GridSize + bitIdx] = 255;
+            }
+            else
+            {
+                FrameBuffer[pixelY * mWidth + pixelX] = 255;
+            }
+        }
+
+        void StoreTiles(const TileScratch &scratch, int x0, int y, int count, const Mask *tileMasks)
+        {
+            if(!scratch.SharedCoverage)
+            {
+                StoreTiles(x0, y, count, tileMasks);
+                return;
+            }
+            Mask *tileMasksOut = scratch.SharedCoverage + static_cast<size_t>(y) * mTilesX + x0;
+            for(int i = 0; i < count; ++i)
+            {
+                if(tileMasks[i] != Mask{})
+                {
+                    RasterKernels::AtomicOr(tileMasksOut[i], tileMasks[i]);
+                }
+            }
+        }
+
+        // Writes `count` tile masks of tile row y starting at tile column x0, all inside the grid
+        void StoreTiles(int x0, int y, int count, const Mask *tileMasks)
+        {
+            if(mLayout == FrameBufferLayout::Coverage)
+            {
+                Mask *tileMasksOut = &CoverageBuffer[static_cast<size_t>(y) * mTilesX + x0];
+                for(int i = 0; i < count; ++i)
+                {
+                    tileMasksOut[i] |= tileMasks[i];
+                }
+                return;
+            }
+            if(mLayout == FrameBufferLayout::Tiled)
+            {
+                // Tiles own their padding, so every tile of the grid is written whole
+                for(int i = 0; i < count; ++i)
+                {
+                    uint8_t *tile = &FrameBuffer[(static_cast<size_t>(y) * mTilesX + x0 + i) * GridSize * GridSize];
+                    mKernels.WriteTile(tile, GridSize, tileMasks[i]);
+                }
+                return;
+            }
+
+            // Only the last tile column and row can stick out of a Linear framebuffer
+            int whole = y < mHeight / GridSize ? std::min(x0 + count, mWidth / GridSize) - x0 : 0;
+            for(int i = 0; i < whole; ++i)
+            {
+                mKernels.WriteTile(&FrameBuffer[(y * GridSize * mWidth + (x0 + i) * GridSize)], mWidth, tileMasks[i]);
+            }
+            for(int i = std::max(whole, 0); i < count; ++i)
+            {
+                WriteTileClipped(x0 + i, y, tileMasks[i]);
+            }
+        }
+
+        // Border tile of the Linear layout, its rows are cut at the screen edge
+        void WriteTileClipped(int x, int y, const Mask &finalBitmask)
+        {
+            int rows = std::min(GridSize, mHeight - y * GridSize);
+            int columns = std::min(GridSize, mWidth - x * GridSize);
+            for(int gy = 0; gy < rows; ++gy)
+            {
+                uint32_t bits = RasterKernels::RowBits<GridSize>(finalBitmask, gy);
+                uint8_t *dst = &FrameBuffer[(y * GridSize + gy) * mWidth + x * GridSize];
+                for(int gx = 0; gx < columns; gx += 8)
+                {
+                    uint64_t pixels = RasterKernels::ExpandRowScalar((bits >> gx) & 0xFF);
+                    uint64_t current = 0;
+                    int bytes = std::min(columns - gx, 8);
+                    std::memcpy(&current, dst + gx, bytes);
+                    current |= pixels;
+                    std::memcpy(dst + gx, &current, bytes);
+                }
+            }
+        }
+
+        void AllocateFrameBuffer()
+        {
+            mTilesX = (mWidth + GridSize - 1) / GridSize;
+            mTilesY = (mHeight + GridSize - 1) / GridSize;
+            FrameBuffer.clear();
+            CoverageBuffer.clear();
+            if(mLayout == FrameBufferLayout::Coverage)
+            {
+                CoverageBuffer.resize(mTilesX * mTilesY, Mask{});
+            }
+            else if(mLayout == FrameBufferLayout::Tiled)
+            {
+                FrameBuffer.resize(mTilesX * mTilesY * GridSize * GridSize, 0);
+            }
+            else
+            {
+                FrameBuffer.resize(mWidth * mHeight, 0);
+            }
+        }
+
+        // The tables are generated at compile time (tables.h), only the pointers are set here.
+        // With a cache path they are mapped from that file instead, see tablecache.h.
+        void PrecomputeRasterizationData()
+        {
+            if(mSymmetricTable)
+            {
+                BindTables(RasterTables::Tables<GridSize, QuantizationResolution, OffsetSample, true>);
+            }
+            else
+            {
+                BindTables(RasterTables::Tables<GridSize, QuantizationResolution, OffsetSample, false>);
+            }
+            if(!mTableCachePath.empty())
+            {
+                if(mSymmetricTable)
+                {
+                    MapTableFile<true>();
+                }
+                else
+                {
+                    MapTableFile<false>();
+                }
+            }
+        }
+
+        // Keeps the built-in tables bound if the file can be neither loaded nor written, which
+        // IsTableFileMapped() reports. Rasterizers with the same file and parameters share one mapping.
+        template <bool Symmetric>
+        void MapTableFile()
+        {
+            using TablesT = RasterTables::BitMaskTables<GridSize, QuantizationResolution, OffsetSample, Symmetric>;
+            const auto &builtIn = RasterTables::Tables<GridSize, QuantizationResolution, OffsetSample, Symmetric>;
+            RasterTables::TableFileHeader header = RasterTables::MakeTableFileHeader<GridSize, QuantizationResolution, OffsetSample, Symmetric>();
+            mTableFile = RasterTables::AcquireTableFile(mTableCachePath, header, mTableHugePages, builtIn);
+            if(!mTableFile)
+            {
+                return;
+            }
+            const TablesT *tables = static_cast<const TablesT *>(mTableFile->Tables);
+            BindTables(*tables);
+        }
+
+        template <typename TablesT>
+        void BindTables(const TablesT &tables)
+        {
+            BitMaskTable = tables.Masks;
+            FirstNonEmptyOffset = tables.FirstNonEmptyOffset;
+            FirstFullOffset = tables.FirstFullOffset;
+        }
+};
+
+using Rasterizer = BasicRasterizer<8, 64, 64>;
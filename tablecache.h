@@ -0,0 +1,307 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <chrono>
+#include <filesystem>
+#include <type_traits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "tables.h"
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Persistent cache of the BasicRasterizer tables. The file is a versioned header followed by the
+// raw RasterTables::BitMaskTables, and is mapped read-only once per process, so every rasterizer
+// and every process using the same file shares its pages. The header carries a hash of the
+// payload, checked once per mapping, so a file damaged after it was written is not used.
+namespace RasterTables
+{
+    constexpr inline char TableFileMagic[8] = { 'R', 'S', 'T', 'T', 'A', 'B', 'L', 'E' };
+    constexpr inline uint32_t TableFileVersion = 2;   // bump when the table layout or generation changes
+    constexpr inline uint64_t TableFilePayload = 4096; // tables start on a page boundary
+
+    struct TableFileHeader
+    {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t HeaderSize;
+        uint64_t ParamHash;    // HashTableParams of the fields below
+        int32_t GridSize;
+        float GridRange;
+        int32_t QuantizationResolution;
+        int32_t OffsetSample;
+        int32_t Angles;
+        uint32_t MaskBytes;
+        uint64_t PayloadOffset;
+        uint64_t PayloadBytes; // sizeof(BitMaskTables)
+        uint64_t PayloadHash;  // HashBytes of the tables, filled in by WriteTableFile
+    };
+    static_assert(sizeof(TableFileHeader) <= TableFilePayload);
+
+    constexpr inline uint64_t HashSeed = 14695981039346656037ull;
+
+    // FNV-1a, continuing from hash
+    inline uint64_t HashBytes(uint64_t hash, const void *data, size_t size)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        for(size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Over everything that changes the table contents or layout
+    inline uint64_t HashTableParams(const TableFileHeader &header)
+    {
+        uint64_t hash = HashSeed;
+        auto mix = [&](const void *data, size_t size) { hash = HashBytes(hash, data, size); };
+        mix(&header.Version, sizeof(header.Version));
+        mix(&header.GridSize, sizeof(header.GridSize));
+        mix(&header.GridRange, sizeof(header.GridRange));
+        mix(&header.QuantizationResolution, sizeof(header.QuantizationResolution));
+        mix(&header.OffsetSample, sizeof(header.OffsetSample));
+        mix(&header.Angles, sizeof(header.Angles));
+        mix(&header.MaskBytes, sizeof(header.MaskBytes));
+        mix(&header.PayloadBytes, sizeof(header.PayloadBytes));
+        return hash;
+    }
+
+    template <int GridSize, int32_t QuantizationResolution, int32_t OffsetSample, bool Symmetric>
+    TableFileHeader MakeTableFileHeader()
+    {
+        using TablesT = BitMaskTables<GridSize, QuantizationResolution, OffsetSample, Symmetric>;
+        TableFileHeader header{};
+        std::memcpy(header.Magic, TableFileMagic, sizeof(header.Magic));
+        header.Version = TableFileVersion;
+        header.HeaderSize = sizeof(TableFileHeader);
+        header.GridSize = GridSize;
+        header.GridRange = GridRange<GridSize>;
+        header.QuantizationResolution = QuantizationResolution;
+        header.OffsetSample = OffsetSample;
+        header.Angles = TablesT::Angles;
+        header.MaskBytes = sizeof(typename TablesT::Mask);
+        header.PayloadOffset = TableFilePayload;
+        header.PayloadBytes = sizeof(TablesT);
+        header.ParamHash = HashTableParams(header);
+        return header;
+    }
+
+    // Read-only mapping of a whole file
+    class MappedFile
+    {
+        public:
+            MappedFile() = default;
+            MappedFile(const MappedFile &) = delete;
+            MappedFile &operator=(const MappedFile &) = delete;
+            ~MappedFile()
+            {
+                Unmap();
+            }
+
+            // hugePages asks the kernel to back the mapping with transparent huge pages, it is
+            // only a hint and is ignored where unsupported
+            bool Map(const std::string &path, bool hugePages)
+            {
+                Unmap();
+#if defined(_WIN32)
+                (void)hugePages; // large pages need SeLockMemoryPrivilege and cannot back file views
+                HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+                if(file == INVALID_HANDLE_VALUE)
+                {
+                    return false;
+                }
+                LARGE_INTEGER size;
+                if(!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+                {
+                    CloseHandle(file);
+                    return false;
+                }
+                HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                CloseHandle(file);
+                if(!mapping)
+                {
+                    return false;
+                }
+                void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);
+                if(!data)
+                {
+                    return false;
+                }
+                mData = static_cast<const uint8_t *>(data);
+                mSize = static_cast<size_t>(size.QuadPart);
+#else
+                int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                if(fd < 0)
+                {
+                    return false;
+                }
+                struct stat st;
+                if(fstat(fd, &st) != 0 || st.st_size == 0)
+                {
+                    close(fd);
+                    return false;
+                }
+                void *data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+                close(fd);
+                if(data == MAP_FAILED)
+                {
+                    return false;
+                }
+#if defined(MADV_HUGEPAGE)
+                if(hugePages)
+                {
+                    madvise(data, static_cast<size_t>(st.st_size), MADV_HUGEPAGE);
+                }
+#else
+                (void)hugePages;
+#endif
+                mData = static_cast<const uint8_t *>(data);
+                mSize = static_cast<size_t>(st.st_size);
+#endif
+                return true;
+            }
+
+            void Unmap()
+            {
+                if(mData)
+                {
+#if defined(_WIN32)
+                    UnmapViewOfFile(mData);
+#else
+                    munmap(const_cast<uint8_t *>(mData), mSize);
+#endif
+                }
+                mData = nullptr;
+                mSize = 0;
+            }
+
+            const uint8_t *Data() const { return mData; }
+            size_t Size() const { return mSize; }
+
+        private:
+            const uint8_t *mData = nullptr;
+            size_t mSize = 0;
+    };
+
+    // Maps the cache file and returns its tables, or nullptr if the file is missing, truncated,
+    // was written for other parameters or its tables do not match the payload hash
+    template <typename TablesT>
+    const TablesT *LoadTableFile(MappedFile &file, const std::string &path, const TableFileHeader &expected, bool hugePages)
+    {
+        static_assert(std::is_trivially_copyable_v<TablesT>);
+        if(!file.Map(path, hugePages))
+        {
+            return nullptr;
+        }
+        TableFileHeader header;
+        if(file.Size() < sizeof(header))
+        {
+            file.Unmap();
+            return nullptr;
+        }
+        std::memcpy(&header, file.Data(), sizeof(header));
+        bool valid = std::memcmp(header.Magic, expected.Magic, sizeof(header.Magic)) == 0 &&
+                     header.Version == expected.Version && header.HeaderSize == expected.HeaderSize &&
+                     header.ParamHash == expected.ParamHash && HashTableParams(header) == header.ParamHash &&
+                     header.PayloadOffset == expected.PayloadOffset && header.PayloadBytes == expected.PayloadBytes &&
+                     file.Size() >= header.PayloadOffset + header.PayloadBytes &&
+                     HashBytes(HashSeed, file.Data() + header.PayloadOffset, header.PayloadBytes) == header.PayloadHash;
+        if(!valid)
+        {
+            file.Unmap();
+            return nullptr;
+        }
+        return reinterpret_cast<const TablesT *>(file.Data() + header.PayloadOffset);
+    }
+
+    // Writes the file next to its final path and renames it into place, so a concurrent reader
+    // sees either no file or a complete one
+    template <typename TablesT>
+    bool WriteTableFile(const std::string &path, TableFileHeader header, const TablesT &tables)
+    {
+        header.PayloadHash = HashBytes(HashSeed, &tables, sizeof(tables));
+        std::string temp = path + ".tmp" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+        {
+            std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+            if(!out)
+            {
+                return false;
+            }
+            char page[TableFilePayload] = {};
+            std::memcpy(page, &header, sizeof(header));
+            out.write(page, sizeof(page));
+            out.write(reinterpret_cast<const char *>(&tables), sizeof(tables));
+            out.flush();
+            if(!out)
+            {
+                out.close();
+                std::error_code ignored;
+                std::filesystem::remove(temp, ignored);
+                return false;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temp, path, error);
+        if(error)
+        {
+            std::filesystem::remove(temp, error);
+            return false;
+        }
+        return true;
+    }
+
+    // Validated mapping of a cache file, immutable once published
+    struct SharedTableFile
+    {
+        MappedFile File;
+        const void *Tables = nullptr; // BitMaskTables inside File
+    };
+
+    // Returns the process-wide mapping of path for these parameters, loading or writing the file
+    // on first use. The mapping lives as long as any rasterizer holds it. Returns nullptr if the
+    // file can be neither loaded nor written.
+    template <typename TablesT>
+    std::shared_ptr<const SharedTableFile> AcquireTableFile(const std::string &path, const TableFileHeader &header, bool hugePages, const TablesT &builtIn)
+    {
+        static std::mutex mutex;
+        static std::map<std::pair<std::string, uint64_t>, std::weak_ptr<const SharedTableFile>> files;
+        std::lock_guard<std::mutex> lock(mutex);
+        for(auto it = files.begin(); it != files.end();)
+        {
+            it = it->second.expired() ? files.erase(it) : std::next(it);
+        }
+        std::weak_ptr<const SharedTableFile> &entry = files[{ path, header.ParamHash }];
+        if(auto shared = entry.lock())
+        {
+            return shared;
+        }
+
+        auto file = std::make_shared<SharedTableFile>();
+        const TablesT *tables = LoadTableFile<TablesT>(file->File, path, header, hugePages);
+        if(!tables && WriteTableFile(path, header, builtIn))
+        {
+            tables = LoadTableFile<TablesT>(file->File, path, header, hugePages);
+        }
+        if(!tables)
+        {
+            return nullptr;
+        }
+        file->Tables = tables;
+        entry = file;
+        return file;
+    }
+}
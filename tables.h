@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include "kernels.h"
+
+// Half-plane coverage tables of BasicRasterizer. They are generated by the compiler and end up
+// read-only in the binary, so constructing a rasterizer does no table work and every process
+// running the binary shares the same pages.
+namespace RasterTables
+{
+    // Offset range covered by the table, in pixels
+    template <int GridSize>
+    constexpr float GridRange = 4.0f * GridSize; // 32 for 8x8 tiles
+
+    // std::sqrt is not constexpr. Newton's method in double rounded once to float gives the
+    // correctly rounded float result, the same as std::sqrt(float).
+    constexpr float Sqrt(float value)
+    {
+        double x = value;
+        double root = x > 1.0 ? x : 1.0;
+        for(int i = 0; i < 64; ++i)
+        {
+            double next = 0.5 * (root + x / root);
+            if(next >= root)
+            {
+                break;
+            }
+            root = next;
+        }
+        return static_cast<float>(root);
+    }
+
+    template <int GridSize, int32_t QuantizationResolution, int32_t OffsetSample, bool Symmetric>
+    struct BitMaskTables
+    {
+        using Mask = RasterKernels::TileMask<GridSize>;
+        // Every octant, or only nx >= ny >= 0 for the symmetric table, see BasicRasterizer::OctantAngle
+        static constexpr int Angles = Symmetric ? QuantizationResolution : 8 * QuantizationResolution;
+
+        Mask Masks[Angles * OffsetSample] = {};  // [angle][offset index]
+        int32_t FirstNonEmptyOffset[Angles] = {}; // per angle, smallest offset index with a non-empty mask
+        int32_t FirstFullOffset[Angles] = {};     // per angle, smallest offset index with a full mask
+    };
+
+    template <int GridSize, int32_t QuantizationResolution, int32_t OffsetSample, bool Symmetric>
+    constexpr BitMaskTables<GridSize, QuantizationResolution, OffsetSample, Symmetric> Generate()
+    {
+        using Tables = BitMaskTables<GridSize, QuantizationResolution, OffsetSample, Symmetric>;
+        using Mask = typename Tables::Mask;
+        constexpr float Range = GridRange<GridSize>;
+
+        Tables tables{};
+        for(int angle = 0; angle < Tables::Angles; ++angle)
+        {
+            // Direction in the middle of the angle's ratio step
+            int octant = angle / QuantizationResolution;
+            float ratio = (angle % QuantizationResolution + 0.5f) / QuantizationResolution;
+            float major = 1.0f / Sqrt(1.0f + ratio * ratio);
+            float minor = ratio * major;
+            float nx = (octant & 1) ? minor : major;
+            float ny = (octant & 1) ? major : minor;
+            nx = (octant & 2) ? -nx : nx;
+            ny = (octant & 4) ? -ny : ny;
+
+            // The distance of a sample only grows with the offset index, so each sample has a first
+            // covering index and the masks of the angle are running ORs over them. The index is
+            // estimated by inverting the offset mapping, then snapped with the same float expression
+            // a direct evaluation of every entry would use.
+            auto covers = [&](float distance, int k)
+            {
+                float nk = ((float)k / OffsetSample - 0.5f) * Range; // -GridRange/2 ~ GridRange/2
+                return distance + nk >= 0;
+            };
+            Mask firstCovered[OffsetSample + 1] = {};
+            for(int y = 0; y < GridSize; ++y)
+            {
+                for(int x = 0; x < GridSize; ++x)
+                {
+                    float sampleX = (float)(x) + 0.5f;
+                    float sampleY = (float)(y) + 0.5f;
+                    float distance = sampleX * nx + sampleY * ny;
+                    float estimate = (0.5f - distance / Range) * OffsetSample;
+                    int first = estimate <= 0 ? 0 : estimate >= OffsetSample ? OffsetSample : static_cast<int>(estimate);
+                    while(first > 0 && covers(distance, first - 1))
+                    {
+                        --first;
+                    }
+                    while(first < OffsetSample && !covers(distance, first))
+                    {
+                        ++first;
+                    }
+                    RasterKernels::SetBit(firstCovered[first], y * GridSize + x);
+                }
+            }
+
+            Mask mask{};
+            tables.FirstNonEmptyOffset[angle] = OffsetSample;
+            tables.FirstFullOffset[angle] = OffsetSample;
+            for(int k = 0; k < OffsetSample; ++k)
+            {
+                mask |= firstCovered[k];
+                tables.Masks[angle * OffsetSample + k] = mask;
+                if(mask != Mask{} && tables.FirstNonEmptyOffset[angle] == OffsetSample)
+                {
+                    tables.FirstNonEmptyOffset[angle] = k;
+                }
+                if(mask == RasterKernels::FullMask<Mask>() && tables.FirstFullOffset[angle] == OffsetSample)
+                {
+                    tables.FirstFullOffset[angle] = k;
+                }
+            }
+        }
+        return tables;
+    }
+
+    template <int GridSize, int32_t QuantizationResolution, int32_t OffsetSample, bool Symmetric>
+    inline constexpr BitMaskTables<GridSize, QuantizationResolution, OffsetSample, Symmetric> Tables =
+        Generate<GridSize, QuantizationResolution, OffsetSample, Symmetric>();
+}
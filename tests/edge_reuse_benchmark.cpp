@@ -0,0 +1,320 @@
+// Measures whether indexed meshes and strips would gain from setting up each shared edge
+// once. Runs the per-edge part of the fixed-point setup (SetupSnappedTriangle) over a jittered
+// grid mesh, once per triangle as the rasterizer does and once with edge reuse, checks that
+// both give the same bits and prints the best of a few runs. Not a CTest test, run it by hand
+// on a quiet machine.
+#include "rasterizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+    constexpr int Width = 1920;
+    constexpr int Height = 1080;
+    constexpr int Columns = 1000; // grid quads per row, two triangles each
+    constexpr int Rows = 1000;
+    constexpr int Runs = 10;
+
+    constexpr int SubpixelBits = 8; // as in Rasterizer
+    constexpr int GridSize = Rasterizer::GridSize;
+    constexpr int32_t OffsetSample = Rasterizer::OffsetSample;
+    constexpr int32_t QuantizationResolution = Rasterizer::QuantizationResolution;
+    constexpr int32_t GridRangeFixed = static_cast<int32_t>(Rasterizer::GridRange);
+    constexpr int64_t One = int64_t(1) << RasterKernels::FixedShift;
+
+    // The per-edge values of SetupSnappedTriangle that do not depend on the triangle
+    struct Edge
+    {
+        int64_t Nx, Ny;
+        int64_t DeltaY;
+        int32_t DeltaX;
+        int32_t Step;    // angle step inside the octant
+        uint8_t Octant;  // symmetric table, so this is also the symmetry op
+    };
+
+    // What the triangle setup hands to traversal, minus the table pointers
+    struct TriangleSetup
+    {
+        int64_t Offset[3];
+        Edge Edges[3];
+        int MinY;
+    };
+
+    struct Mesh
+    {
+        std::vector<int64_t> X, Y; // snapped to subpixels
+        std::vector<uint32_t> Indices;
+    };
+
+    int64_t IntegerSqrt(int64_t value)
+    {
+        int64_t root = static_cast<int64_t>(std::sqrt(static_cast<double>(value)));
+        while(root > 0 && root * root > value)
+        {
+            --root;
+        }
+        while((root + 1) * (root + 1) <= value)
+        {
+            ++root;
+        }
+        return root;
+    }
+
+    uint8_t OctantOf(int64_t nx, int64_t ny)
+    {
+        return static_cast<uint8_t>((ny < 0) << 2 | (nx < 0) << 1 | (std::abs(ny) > std::abs(nx)));
+    }
+
+    // Edge from vertex a to vertex b, false for coincident vertices
+    bool SetupEdge(const Mesh &mesh, uint32_t a, uint32_t b, Edge &edge)
+    {
+        int64_t ex = mesh.X[a] - mesh.X[b];
+        int64_t ey = mesh.Y[a] - mesh.Y[b];
+        int64_t length = IntegerSqrt(ex * ex + ey * ey);
+        if(length == 0)
+        {
+            return false;
+        }
+        edge.Nx = ey * One / length;
+        edge.Ny = -ex * One / length;
+        edge.DeltaY = edge.Ny * GridSize * OffsetSample / GridRangeFixed;
+        edge.DeltaX = static_cast<int32_t>(edge.Nx * GridSize * OffsetSample / GridRangeFixed);
+        int64_t ax = std::abs(edge.Nx);
+        int64_t ay = std::abs(edge.Ny);
+        bool steep = ay > ax;
+        int64_t step = steep ? ax * QuantizationResolution / ay : ay * QuantizationResolution / ax;
+        edge.Step = static_cast<int32_t>(std::min<int64_t>(step, QuantizationResolution - 1));
+        edge.Octant = OctantOf(edge.Nx, edge.Ny);
+        return true;
+    }
+
+    // The same edge walked the other way. Integer division truncates toward zero, so every
+    // product and quotient is the exact negation of the forward one; only the octant moves.
+    Edge Reversed(const Edge &edge)
+    {
+        Edge reversed = edge;
+        reversed.Nx = -edge.Nx;
+        reversed.Ny = -edge.Ny;
+        reversed.DeltaY = -edge.DeltaY;
+        reversed.DeltaX = -edge.DeltaX;
+        reversed.Octant = OctantOf(reversed.Nx, reversed.Ny);
+        return reversed;
+    }
+
+    // The per-triangle rest of the setup: the bounding box row and the corner offsets
+    void FinishTriangle(const Mesh &mesh, const uint32_t *corners, TriangleSetup &tri)
+    {
+        int64_t minY = std::min({ mesh.Y[corners[0]], mesh.Y[corners[1]], mesh.Y[corners[2]] });
+        tri.MinY = static_cast<int>(std::clamp<int64_t>(minY >> SubpixelBits, 0, Height)) / GridSize;
+        for(int e = 0; e < 3; ++e)
+        {
+            int64_t cornerX = -mesh.X[corners[e]];
+            int64_t cornerY = static_cast<int64_t>(tri.MinY) * GridSize * (1 << SubpixelBits) - mesh.Y[corners[e]];
+            int64_t distance = (tri.Edges[e].Nx * cornerX + tri.Edges[e].Ny * cornerY) >> SubpixelBits;
+            tri.Offset[e] = distance * OffsetSample / GridRangeFixed + (int64_t(OffsetSample / 2) << RasterKernels::FixedShift);
+        }
+    }
+
+    // Every triangle sets up its three edges, as the rasterizer does
+    void SetupEveryEdge(const Mesh &mesh, std::vector<TriangleSetup> &out)
+    {
+        size_t triangles = mesh.Indices.size() / 3;
+        for(size_t i = 0; i < triangles; ++i)
+        {
+            const uint32_t *corners = &mesh.Indices[i * 3];
+            TriangleSetup &tri = out[i];
+            bool valid = true;
+            for(int e = 0; e < 3; ++e)
+            {
+                valid &= SetupEdge(mesh, corners[e], corners[(e + 1) % 3], tri.Edges[e]);
+            }
+            if(valid)
+            {
+                FinishTriangle(mesh, corners, tri);
+            }
+        }
+    }
+
+    // Direct-mapped cache of edges keyed by vertex pair, stored in the direction of the lower index
+    void SetupWithEdgeCache(const Mesh &mesh, std::vector<TriangleSetup> &out)
+    {
+        constexpr uint32_t Slots = 4096;
+        struct Entry
+        {
+            uint32_t Low = ~0u, High = ~0u;
+            Edge Forward;
+        };
+        std::vector<Entry> cache(Slots);
+        size_t triangles = mesh.Indices.size() / 3;
+        for(size_t i = 0; i < triangles; ++i)
+        {
+            const uint32_t *corners = &mesh.Indices[i * 3];
+            TriangleSetup &tri = out[i];
+            bool valid = true;
+            for(int e = 0; e < 3; ++e)
+            {
+                uint32_t a = corners[e];
+                uint32_t b = corners[(e + 1) % 3];
+                uint32_t low = std::min(a, b);
+                uint32_t high = std::max(a, b);
+                Entry &entry = cache[(low * 2654435761u ^ high) & (Slots - 1)];
+                if(entry.Low != low || entry.High != high)
+                {
+                    entry.Low = low;
+                    entry.High = high;
+                    if(!SetupEdge(mesh, low, high, entry.Forward))
+                    {
+                        entry.Low = ~0u;
+                        valid = false;
+                        continue;
+                    }
+                }
+                tri.Edges[e] = a == low ? entry.Forward : Reversed(entry.Forward);
+            }
+            if(valid)
+            {
+                FinishTriangle(mesh, corners, tri);
+            }
+        }
+    }
+
+    // Only the edges shared with the previous triangle are reused, no cache
+    void SetupWithPreviousTriangle(const Mesh &mesh, std::vector<TriangleSetup> &out)
+    {
+        size_t triangles = mesh.Indices.size() / 3;
+        const uint32_t *previous = nullptr;
+        for(size_t i = 0; i < triangles; ++i)
+        {
+            const uint32_t *corners = &mesh.Indices[i * 3];
+            TriangleSetup &tri = out[i];
+            bool valid = true;
+            for(int e = 0; e < 3; ++e)
+            {
+                uint32_t a = corners[e];
+                uint32_t b = corners[(e + 1) % 3];
+                int shared = -1;
+                for(int p = 0; previous && p < 3; ++p)
+                {
+                    shared = (previous[p] == b && previous[(p + 1) % 3] == a) ? p : shared;
+                }
+                if(shared >= 0)
+                {
+                    tri.Edges[e] = Reversed(out[i - 1].Edges[shared]);
+                }
+                else
+                {
+                    valid &= SetupEdge(mesh, a, b, tri.Edges[e]);
+                }
+            }
+            if(valid)
+            {
+                FinishTriangle(mesh, corners, tri);
+            }
+            previous = valid ? corners : nullptr;
+        }
+    }
+
+    // Grid of Columns x Rows quads over the screen, every vertex jittered by up to a third of
+    // a quad so the edges take all directions, counter-clockwise as the rasterizer expects.
+    // With strips, each row of quads is the strip RasterizeStrip would draw, expanded into its
+    // triangles in order, odd ones with their first two corners swapped.
+    Mesh GridMesh(bool strips)
+    {
+        Mesh mesh;
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> jitter(-0.33, 0.33);
+        double quadWidth = double(Width << SubpixelBits) / Columns;
+        double quadHeight = double(Height << SubpixelBits) / Rows;
+        for(int y = 0; y <= Rows; ++y)
+        {
+            for(int x = 0; x <= Columns; ++x)
+            {
+                mesh.X.push_back(std::llround((x + jitter(rng)) * quadWidth));
+                mesh.Y.push_back(std::llround((y + jitter(rng)) * quadHeight));
+            }
+        }
+        auto vertex = [](int x, int y) { return static_cast<uint32_t>(y * (Columns + 1) + x); };
+        for(int y = 0; y < Rows; ++y)
+        {
+            if(strips)
+            {
+                auto strip = [&](int i) { return vertex(i / 2, y + (~i & 1)); };
+                for(int i = 0; i < Columns * 2; ++i)
+                {
+                    mesh.Indices.insert(mesh.Indices.end(), { strip(i + (i & 1)), strip(i + 1 - (i & 1)), strip(i + 2) });
+                }
+                continue;
+            }
+            for(int x = 0; x < Columns; ++x)
+            {
+                mesh.Indices.insert(mesh.Indices.end(), { vertex(x, y), vertex(x + 1, y), vertex(x + 1, y + 1) });
+                mesh.Indices.insert(mesh.Indices.end(), { vertex(x, y), vertex(x + 1, y + 1), vertex(x, y + 1) });
+            }
+        }
+        return mesh;
+    }
+
+    bool Same(const std::vector<TriangleSetup> &a, const std::vector<TriangleSetup> &b)
+    {
+        for(size_t i = 0; i < a.size(); ++i)
+        {
+            if(a[i].MinY != b[i].MinY)
+            {
+                return false;
+            }
+            for(int e = 0; e < 3; ++e)
+            {
+                const Edge &x = a[i].Edges[e];
+                const Edge &y = b[i].Edges[e];
+                if(a[i].Offset[e] != b[i].Offset[e] || x.Nx != y.Nx || x.Ny != y.Ny || x.DeltaY != y.DeltaY ||
+                   x.DeltaX != y.DeltaX || x.Step != y.Step || x.Octant != y.Octant)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    template <typename Setup>
+    double BestMilliseconds(Setup &&setup)
+    {
+        double best = 1e30;
+        for(int run = 0; run < Runs; ++run)
+        {
+            auto start = std::chrono::steady_clock::now();
+            setup();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return best;
+    }
+
+    void Report(const char *mesh, const char *what, double milliseconds, double baseline, bool same)
+    {
+        std::printf("%-16s %-26s %8.2f ms %+6.1f%%%s\n", mesh, what, milliseconds,
+                    100.0 * (milliseconds - baseline) / baseline, same ? "" : "  DIFFERENT BITS");
+    }
+}
+
+int main()
+{
+    for(bool strips : { false, true })
+    {
+        Mesh grid = GridMesh(strips);
+        const char *name = strips ? "grid strips" : "grid list";
+        size_t triangles = grid.Indices.size() / 3;
+        std::vector<TriangleSetup> expected(triangles), actual(triangles);
+
+        double everyEdge = BestMilliseconds([&] { SetupEveryEdge(grid, expected); });
+        Report(name, "every edge", everyEdge, everyEdge, true);
+        double cached = BestMilliseconds([&] { SetupWithEdgeCache(grid, actual); });
+        Report(name, "edge cache", cached, everyEdge, Same(expected, actual));
+        double previous = BestMilliseconds([&] { SetupWithPreviousTriangle(grid, actual); });
+        Report(name, "previous triangle", previous, everyEdge, Same(expected, actual));
+    }
+    return 0;
+}
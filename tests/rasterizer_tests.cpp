@@ -0,0 +1,825 @@
+// Checks of the rasterizer invariants, run by CTest. A failed check prints what differed and
+// fails the run.
+#include "rasterizer.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <random>
+
+namespace
+{
+    constexpr int Width = 1001; // not a multiple of the tile size, so the border tiles are partial
+    constexpr int Height = 637;
+
+    constexpr int32_t OffsetSample = Rasterizer::OffsetSample;
+    constexpr float GridRange = Rasterizer::GridRange;
+    constexpr int32_t TileBatch = 64; // tiles per kernel call in the kernel checks
+
+    int gFailures = 0;
+
+    void Check(bool condition, const char *what)
+    {
+        if(!condition)
+        {
+            std::printf("FAILED: %s\n", what);
+            ++gFailures;
+        }
+    }
+
+    // Triangles with corners in [-1.1, 1.1] NDC, from a few pixels to half the screen across.
+    // frontFacing orders them so RasterizePrototype1 draws them.
+    std::vector<glm::vec3> RandomTriangles(int count, unsigned seed, bool frontFacing)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> center(-1.1f, 1.1f);
+        std::uniform_real_distribution<float> size(0.01f, 0.5f);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::vector<glm::vec3> vertices;
+        for(int i = 0; i < count; ++i)
+        {
+            glm::vec3 c(center(rng), center(rng), 0.0f);
+            float s = size(rng);
+            glm::vec3 v[3];
+            for(glm::vec3 &p : v)
+            {
+                p = c + glm::vec3(unit(rng) * s, unit(rng) * s, 0.0f);
+            }
+            float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+            if(frontFacing && area < 0)
+            {
+                std::swap(v[1], v[2]);
+            }
+            vertices.insert(vertices.end(), v, v + 3);
+        }
+        return vertices;
+    }
+
+    template <typename RasterizerT = Rasterizer>
+    std::vector<uint8_t> Render(const RasterizerOptions &options, std::vector<glm::vec3> vertices)
+    {
+        RasterizerT rasterizer(Width, Height, options);
+        rasterizer.RasterizePrototype3(vertices);
+        return rasterizer.GetLinearFrameBuffer();
+    }
+
+    // Owns the arrays behind a VertexStreams
+    struct Streams
+    {
+        std::vector<float> X, Y, Z;
+
+        explicit Streams(const std::vector<glm::vec4> &positions)
+        {
+            for(const glm::vec4 &p : positions)
+            {
+                X.push_back(p.x);
+                Y.push_back(p.y);
+                Z.push_back(p.z);
+            }
+        }
+
+        VertexStreams View() const
+        {
+            VertexStreams streams;
+            streams.X = X.data();
+            streams.Y = Y.data();
+            streams.Z = Z.data();
+            streams.Count = static_cast<int>(X.size());
+            return streams;
+        }
+    };
+
+    template <typename RasterizerT = Rasterizer>
+    std::vector<uint8_t> RenderPrototype1(std::vector<glm::vec3> triangles)
+    {
+        RasterizerT exact(Width, Height);
+        exact.RasterizePrototype1(triangles);
+        return exact.GetLinearFrameBuffer();
+    }
+
+    // Signed distance in pixels of the pixel center to the nearest edge of the triangle, positive
+    // inside, with the edge functions of RasterizePrototype1
+    double EdgeDistance(const glm::vec3 *triangle, int pixelX, int pixelY)
+    {
+        double x[3], y[3];
+        for(int k = 0; k < 3; ++k)
+        {
+            x[k] = (triangle[k].x + 1.0) * 0.5 * Width;
+            y[k] = (triangle[k].y + 1.0) * 0.5 * Height;
+        }
+        double nearest = 1e30;
+        for(int e = 0; e < 3; ++e)
+        {
+            int a = e;
+            int b = (e + 1) % 3;
+            double ex = x[a] - x[b];
+            double ey = y[a] - y[b];
+            double length = std::sqrt(ex * ex + ey * ey);
+            double c = x[a] * y[b] - y[a] * x[b];
+            nearest = std::min(nearest, (ey * (pixelX + 0.5) - ex * (pixelY + 0.5) + c) / length);
+        }
+        return nearest;
+    }
+
+    // Pixels where the two framebuffers disagree that are more than tolerance pixels away from
+    // every edge
+    int PixelsDifferingAwayFromEdges(const std::vector<uint8_t> &expected, const std::vector<uint8_t> &actual, const std::vector<glm::vec3> &triangles, double tolerance = 1.0)
+    {
+        int far = 0;
+        for(int y = 0; y < Height; ++y)
+        {
+            for(int x = 0; x < Width; ++x)
+            {
+                if((expected[y * Width + x] != 0) == (actual[y * Width + x] != 0))
+                {
+                    continue;
+                }
+                bool nearEdge = false;
+                for(size_t t = 0; t < triangles.size() && !nearEdge; t += 3)
+                {
+                    nearEdge = std::abs(EdgeDistance(&triangles[t], x, y)) <= tolerance;
+                }
+                far += !nearEdge;
+            }
+        }
+        return far;
+    }
+
+    // The tile masks quantize the edge angle and offset, so coverage may differ from the exact
+    // per-pixel edge functions of RasterizePrototype1, but only next to an edge. An offset step is
+    // GridRange / OffsetSample pixels, a whole pixel for 16x16 tiles at 64 offsets, and the angle
+    // step adds a little across the tile.
+    template <typename RasterizerT>
+    void TestCoverageMatchesPrototype1()
+    {
+        std::vector<glm::vec3> triangles = RandomTriangles(300, 1, true);
+        std::vector<uint8_t> expected = RenderPrototype1<RasterizerT>(triangles);
+        double tolerance = std::max(1.0, 1.25 * RasterizerT::GridRange / RasterizerT::OffsetSample);
+        for(bool fixedPoint : { false, true })
+        {
+            for(bool symmetric : { false, true })
+            {
+                RasterizerOptions options;
+                options.FixedPoint = fixedPoint;
+                options.SymmetricTable = symmetric;
+                std::vector<uint8_t> actual = Render<RasterizerT>(options, triangles);
+                int far = PixelsDifferingAwayFromEdges(expected, actual, triangles, tolerance);
+                if(far)
+                {
+                    std::printf("  %dx%d tiles, fixed point %d, symmetric table %d: %d pixels differ away from the edges\n", RasterizerT::GridSize, RasterizerT::GridSize, fixedPoint, symmetric, far);
+                }
+                Check(far == 0, "RasterizePrototype3 matches RasterizePrototype1 up to the edges");
+            }
+        }
+    }
+
+    // The fixed-point snap cannot take a vertex past the guard band, so clip-space and NDC input
+    // are both clipped there. Two vertices are past the same guard plane, so the clipped polygon
+    // is still one triangle with the edges of the original. A triangle with every vertex past the
+    // guard band that covers the screen must still fill it.
+    void TestFixedPointGuardBand()
+    {
+        std::vector<glm::vec3> triangle = { { -0.5f, -0.5f, 0.0f }, { 3000.0f, -100.0f, 0.0f }, { 3000.0f, 100.0f, 0.0f } };
+        std::vector<glm::vec4> positions;
+        for(const glm::vec3 &v : triangle)
+        {
+            positions.emplace_back(v, 1.0f);
+        }
+        std::vector<uint8_t> expected = RenderPrototype1(triangle);
+
+        RasterizerOptions options;
+        options.FixedPoint = true;
+        Rasterizer clipped(Width, Height, options);
+        clipped.RasterizeClipSpace(positions, glm::mat4(1.0f));
+        Check(PixelsDifferingAwayFromEdges(expected, clipped.GetLinearFrameBuffer(), triangle) == 0,
+              "fixed point clips clip-space triangles at the guard band");
+
+        Rasterizer ndc(Width, Height, options);
+        ndc.RasterizePrototype3(triangle);
+        Check(PixelsDifferingAwayFromEdges(expected, ndc.GetLinearFrameBuffer(), triangle) == 0,
+              "fixed point clips NDC triangles at the guard band");
+        Check(ndc.GetTraversalStats().TrianglesSubmitted == 1 && ndc.GetTraversalStats().TrianglesOutOfRange == 0,
+              "fixed point counts the cut triangle once");
+
+        std::vector<glm::vec3> cover = { { -100.0f, -1.5f, 0.0f }, { 100.0f, -1.5f, 0.0f }, { 0.0f, 100.0f, 0.0f } };
+        Rasterizer covering(Width, Height, options);
+        covering.RasterizePrototype3(cover);
+        std::vector<uint8_t> frameBuffer = covering.GetLinearFrameBuffer();
+        Check(std::count(frameBuffer.begin(), frameBuffer.end(), 0) == 0, "fixed point fills the screen with a clipped NDC triangle");
+    }
+
+    // A tile far from the edges of a huge triangle has an offset index far outside the int range,
+    // it must still clamp to the first or last table entry. A triangle with corners around 1e7 NDC
+    // covers the whole screen with every kernel set, in NDC and through the clip-space front end.
+    // Its bottom edge runs just below the screen, so where the fixed-point path cuts it at the
+    // guard band the inner edges of the pieces stay far off screen.
+    void TestHugeTriangleFillsScreen()
+    {
+        using RasterKernels::KernelIsa;
+        std::vector<glm::vec3> triangle = { { -1e7f, -1.5f, 0.0f }, { 1e7f, -1.5f, 0.0f }, { 0.0f, 1e7f, 0.0f } };
+        std::vector<glm::vec4> positions;
+        for(const glm::vec3 &v : triangle)
+        {
+            positions.emplace_back(v, 1.0f);
+        }
+        auto filled = [](const std::vector<uint8_t> &frameBuffer)
+        {
+            return std::count(frameBuffer.begin(), frameBuffer.end(), 0) == 0;
+        };
+        for(bool fixedPoint : { false, true })
+        {
+            for(KernelIsa isa : { KernelIsa::Scalar, KernelIsa::SSE42, KernelIsa::AVX2, KernelIsa::AVX512 })
+            {
+                RasterizerOptions options;
+                options.FixedPoint = fixedPoint;
+                options.Isa = isa;
+                if(Rasterizer(Width, Height, options).GetKernelIsa() != isa)
+                {
+                    continue;
+                }
+                Check(filled(Render(options, triangle)), "a huge NDC triangle fills the screen");
+                Rasterizer clipSpace(Width, Height, options);
+                clipSpace.RasterizeClipSpace(positions, glm::mat4(1.0f));
+                Check(filled(clipSpace.GetLinearFrameBuffer()), "a huge clip-space triangle fills the screen");
+            }
+        }
+    }
+
+    bool SameTriangleCounts(const TraversalStats &a, const TraversalStats &b)
+    {
+        return a.TrianglesSubmitted == b.TrianglesSubmitted && a.TrianglesDegenerate == b.TrianglesDegenerate &&
+               a.TrianglesFaceCulled == b.TrianglesFaceCulled && a.TrianglesOffScreen == b.TrianglesOffScreen &&
+               a.TrianglesOutOfRange == b.TrianglesOutOfRange;
+    }
+
+    // Every input triangle is counted once, whatever the front end and threading: the ones behind
+    // the near plane as off screen, the ones cut by it only as submitted, not once per piece
+    void TestTriangleCounts()
+    {
+        std::vector<glm::vec4> positions;
+        for(const glm::vec3 &v : RandomTriangles(300, 3, false))
+        {
+            positions.emplace_back(v, 1.0f);
+        }
+        Rasterizer reference(Width, Height);
+        reference.RasterizeClipSpace(positions, glm::mat4(1.0f));
+        TraversalStats expected = reference.GetTraversalStats();
+        Check(expected.TrianglesSubmitted == 300, "RasterizeClipSpace counts every triangle");
+
+        for(int i = 0; i < 10; ++i)
+        {
+            float x = -0.8f + 0.15f * i;
+            glm::vec4 behind[3] = { { x, 0.0f, -3.0f, 1.0f }, { x + 0.1f, 0.0f, -3.0f, 1.0f }, { x, 0.1f, -2.5f, 1.0f } };
+            glm::vec4 crossing[3] = { { x, -0.5f, 0.0f, 1.0f }, { x + 0.1f, -0.5f, 0.5f, 1.0f }, { x, -0.4f, -3.0f, 1.0f } };
+            positions.insert(positions.end(), behind, behind + 3);
+            positions.insert(positions.end(), crossing, crossing + 3);
+        }
+        expected.TrianglesSubmitted += 20;
+        expected.TrianglesOffScreen += 10;
+        Streams streams(positions);
+
+        for(int threads : { 1, 4 })
+        {
+            for(ParallelMode mode : { ParallelMode::SortMiddle, ParallelMode::SortLast })
+            {
+                RasterizerOptions options;
+                options.Threads = threads;
+                options.Parallel = mode;
+                Rasterizer clipSpace(Width, Height, options);
+                clipSpace.RasterizeClipSpace(positions, glm::mat4(1.0f));
+                Check(SameTriangleCounts(clipSpace.GetTraversalStats(), expected), "RasterizeClipSpace counts every triangle once");
+                Rasterizer screen(Width, Height, options);
+                screen.RasterizeStreams(streams.View(), glm::mat4(1.0f));
+                Check(SameTriangleCounts(screen.GetTraversalStats(), expected), "RasterizeStreams counts every triangle once");
+            }
+        }
+    }
+
+    // Threaded stream and indexed draws follow RasterizerOptions::Parallel: SortMiddle bins them
+    // like RasterizeClipSpace, down to the tile counters, and SortLast draws what the
+    // single-threaded screen batches draw
+    void TestStreamsFollowParallelMode()
+    {
+        std::vector<glm::vec4> positions;
+        for(const glm::vec3 &v : RandomTriangles(300, 10, false))
+        {
+            positions.emplace_back(v, 1.0f);
+        }
+        Streams streams(positions);
+        std::vector<uint32_t> indices(positions.size());
+        std::iota(indices.begin(), indices.end(), 0u);
+        auto sameTiles = [](const TraversalStats &a, const TraversalStats &b)
+        {
+            return a.TilesInBounds == b.TilesInBounds && a.TilesLookedUp == b.TilesLookedUp && a.TilesFilled == b.TilesFilled &&
+                   a.TilesSkipped == b.TilesSkipped && a.SuperTilesAccepted == b.SuperTilesAccepted && a.SuperTilesRejected == b.SuperTilesRejected;
+        };
+        for(bool fixedPoint : { false, true })
+        {
+            RasterizerOptions options;
+            options.FixedPoint = fixedPoint;
+            Rasterizer serial(Width, Height, options);
+            serial.RasterizeStreams(streams.View(), glm::mat4(1.0f));
+
+            options.Threads = 4;
+            options.Parallel = ParallelMode::SortMiddle;
+            Rasterizer binned(Width, Height, options);
+            binned.RasterizeClipSpace(positions, glm::mat4(1.0f));
+            Rasterizer sortMiddle(Width, Height, options);
+            sortMiddle.RasterizeStreams(streams.View(), glm::mat4(1.0f));
+            Check(sortMiddle.GetLinearFrameBuffer() == binned.GetLinearFrameBuffer() && sameTiles(sortMiddle.GetTraversalStats(), binned.GetTraversalStats()),
+                  "SortMiddle RasterizeStreams bins the triangles");
+            Rasterizer indexedSortMiddle(Width, Height, options);
+            indexedSortMiddle.RasterizeIndexed(streams.View(), indices, glm::mat4(1.0f));
+            Check(indexedSortMiddle.GetLinearFrameBuffer() == binned.GetLinearFrameBuffer() && sameTiles(indexedSortMiddle.GetTraversalStats(), binned.GetTraversalStats()),
+                  "SortMiddle RasterizeIndexed bins the triangles");
+
+            options.Parallel = ParallelMode::SortLast;
+            Rasterizer sortLast(Width, Height, options);
+            sortLast.RasterizeStreams(streams.View(), glm::mat4(1.0f));
+            Check(sortLast.GetLinearFrameBuffer() == serial.GetLinearFrameBuffer(), "SortLast RasterizeStreams draws the screen batches");
+            Rasterizer indexedSortLast(Width, Height, options);
+            indexedSortLast.RasterizeIndexed(streams.View(), indices, glm::mat4(1.0f));
+            Check(indexedSortLast.GetLinearFrameBuffer() == serial.GetLinearFrameBuffer(), "SortLast RasterizeIndexed draws the screen batches");
+        }
+    }
+
+    // Every SIMD kernel set the host supports must produce the same masks as the scalar one for
+    // any row, including offsets far outside the table that get clamped and symmetric lookups
+    void TestKernelsMatch()
+    {
+        std::mt19937 rng(1);
+        std::vector<uint64_t> table(3 * OffsetSample);
+        for(uint64_t &mask : table)
+        {
+            mask = (uint64_t(rng()) << 32) | rng();
+        }
+        std::uniform_real_distribution<float> offset(-2.0f * OffsetSample, 3.0f * OffsetSample);
+        std::uniform_real_distribution<float> delta(-1.0f * OffsetSample, 1.0f * OffsetSample);
+        std::vector<RasterKernels::TileRow<uint64_t>> rows(10000);
+        for(RasterKernels::TileRow<uint64_t> &row : rows)
+        {
+            for(int e = 0; e < 3; ++e)
+            {
+                row.Masks[e] = table.data() + e * OffsetSample;
+                row.Symmetry[e] = static_cast<uint8_t>(rng() % 8); // 0 is the full table
+                row.Offset[e] = offset(rng);
+                row.DeltaX[e] = delta(rng);
+            }
+        }
+
+        RasterKernels::CpuFeatures cpu = RasterKernels::DetectCpuFeatures();
+        for(RasterKernels::KernelIsa isa : { RasterKernels::KernelIsa::SSE42, RasterKernels::KernelIsa::AVX2, RasterKernels::KernelIsa::AVX512 })
+        {
+            if(!RasterKernels::IsSupported(isa, cpu))
+            {
+                std::printf("skipped: %s kernels\n", RasterKernels::IsaName(isa));
+                continue;
+            }
+            RasterKernels::KernelSet<uint64_t> kernels = RasterKernels::SelectKernels<8, OffsetSample>(isa);
+            int differing = 0;
+            for(size_t r = 0; r < rows.size(); ++r)
+            {
+                int32_t x0 = static_cast<int32_t>(r % 200);
+                int32_t count = 1 + static_cast<int32_t>(r % TileBatch);
+                uint64_t scalar[TileBatch], simd[TileBatch];
+                RasterKernels::CoverageRowScalar<OffsetSample>(rows[r], x0, count, scalar);
+                kernels.CoverageRow(rows[r], x0, count, simd);
+                differing += !std::equal(scalar, scalar + count, simd);
+            }
+            if(differing)
+            {
+                std::printf("  %s: %d of %zu rows differ\n", RasterKernels::IsaName(isa), differing, rows.size());
+            }
+            Check(differing == 0, "the SIMD kernels match the scalar kernel");
+        }
+    }
+
+    // Every tile writer must set exactly the pixels of the mask bits, like the old bit loop, and
+    // keep what the framebuffer already holds
+    void TestTileWritersMatch()
+    {
+        constexpr int32_t Stride = 24;
+        std::mt19937 rng(3);
+        RasterKernels::CpuFeatures cpu = RasterKernels::DetectCpuFeatures();
+        for(RasterKernels::KernelIsa isa : { RasterKernels::KernelIsa::Scalar, RasterKernels::KernelIsa::SSE42, RasterKernels::KernelIsa::AVX2, RasterKernels::KernelIsa::AVX512 })
+        {
+            if(!RasterKernels::IsSupported(isa, cpu))
+            {
+                continue;
+            }
+            RasterKernels::KernelSet<uint64_t> kernels = RasterKernels::SelectKernels<8, OffsetSample>(isa);
+            int differing = 0;
+            for(int t = 0; t < 10000; ++t)
+            {
+                uint64_t mask = (uint64_t(rng()) << 32) | rng();
+                mask = t == 0 ? 0 : t == 1 ? ~0ull : t % 3 == 0 ? mask & ((uint64_t(rng()) << 32) | rng()) : mask;
+                uint8_t expected[8 * Stride], actual[8 * Stride];
+                for(int i = 0; i < 8 * Stride; ++i)
+                {
+                    expected[i] = actual[i] = rng() % 4 == 0 ? 255 : 0;
+                }
+                for(int gy = 0; gy < 8; ++gy)
+                {
+                    for(int gx = 0; gx < 8; ++gx)
+                    {
+                        if(mask & (1ull << (gy * 8 + gx)))
+                        {
+                            expected[gy * Stride + gx] = 255;
+                        }
+                    }
+                }
+                kernels.WriteTile(actual, Stride, mask);
+                differing += !std::equal(expected, expected + 8 * Stride, actual);
+            }
+            if(differing)
+            {
+                std::printf("  %s: %d of 10000 tiles differ\n", RasterKernels::IsaName(isa), differing);
+            }
+            Check(differing == 0, "the tile writers set the pixels of the mask bits");
+        }
+    }
+
+    // The kernels compute a tile's offset index from the row start instead of adding the step
+    // tile by tile like the old loop did. That rounds differently, but never by more than one
+    // offset index.
+    void TestOffsetsMatchTileLoop()
+    {
+        std::vector<uint64_t> indices(OffsetSample);
+        for(int32_t k = 0; k < OffsetSample; ++k)
+        {
+            indices[k] = k;
+        }
+        const std::vector<uint64_t> all(OffsetSample, ~0ull);
+
+        std::mt19937 rng(2);
+        std::uniform_real_distribution<float> offset(-2.0f * GridRange, 2.0f * GridRange);
+        std::uniform_real_distribution<float> delta(-8.0f, 8.0f);
+        int tiles = 0, apart = 0;
+        for(int r = 0; r < 10000; ++r)
+        {
+            float rowOffset = offset(rng);
+            float deltax = delta(rng);
+            int32_t minX = rng() % 200;
+            int32_t count = 1 + rng() % TileBatch;
+
+            RasterKernels::TileRow<uint64_t> row;
+            row.Masks[0] = indices.data();
+            row.Masks[1] = all.data();
+            row.Masks[2] = all.data();
+            row.Symmetry[0] = row.Symmetry[1] = row.Symmetry[2] = 0;
+            row.Offset[0] = (rowOffset / GridRange - 0.5f) * OffsetSample;
+            row.DeltaX[0] = deltax / GridRange * OffsetSample;
+            for(int e = 1; e < 3; ++e)
+            {
+                row.Offset[e] = 0.0f;
+                row.DeltaX[e] = 0.0f;
+            }
+            uint64_t out[TileBatch];
+            RasterKernels::CoverageRowScalar<OffsetSample>(row, minX, count, out);
+
+            float currentOffset = rowOffset + deltax * minX;
+            for(int32_t i = 0; i < count; ++i)
+            {
+                int offsetIdx = static_cast<int>((currentOffset / GridRange - 0.5f) * OffsetSample);
+                offsetIdx = std::clamp(offsetIdx, 0, OffsetSample - 1);
+                int step = std::abs(static_cast<int>(out[i]) - offsetIdx);
+                apart += step > 1;
+                ++tiles;
+                currentOffset += deltax;
+            }
+        }
+        if(apart)
+        {
+            std::printf("  %d of %d offset indices differ by more than one\n", apart, tiles);
+        }
+        Check(apart == 0, "the row kernels stay within one offset index of the tile loop");
+    }
+
+    // The SIMD kernel sets must produce the same framebuffer as the scalar one, bit for bit.
+    // Kernel sets the host cannot run fall back to another one and are skipped. Seed 4 catches a
+    // scalar multiply-add the compiler fused when the build does not pass -ffp-contract=off.
+    void TestKernelSetsMatchScalar()
+    {
+        using RasterKernels::KernelIsa;
+        for(unsigned seed = 1; seed <= 4; ++seed)
+        {
+            RasterizerOptions options;
+            std::vector<glm::vec3> triangles = RandomTriangles(300, seed, false);
+            for(bool fixedPoint : { false, true })
+            {
+                options.FixedPoint = fixedPoint;
+                options.Isa = KernelIsa::Scalar;
+                std::vector<uint8_t> expected = Render(options, triangles);
+                for(KernelIsa isa : { KernelIsa::SSE42, KernelIsa::AVX2, KernelIsa::AVX512 })
+                {
+                    options.Isa = isa;
+                    if(Rasterizer(Width, Height, options).GetKernelIsa() != isa)
+                    {
+                        continue;
+                    }
+                    Check(Render(options, triangles) == expected, "SIMD kernels match the scalar kernels");
+                }
+            }
+        }
+    }
+
+    // Every traversal option, kernel set and framebuffer layout must draw the same pixels as the
+    // scalar kernels into the linear framebuffer, with the float and the fixed-point setup and
+    // both table layouts.
+    // Kernel sets the host cannot run are skipped, other grid sizes than 8x8 run the SSE4.2
+    // kernels for every SIMD request.
+    template <typename RasterizerT>
+    void TestRenderPathsMatch()
+    {
+        using RasterKernels::KernelIsa;
+        std::vector<glm::vec3> triangles = RandomTriangles(300, 5, false);
+        RasterKernels::CpuFeatures cpu = RasterKernels::DetectCpuFeatures();
+        for(bool fixedPoint : { false, true })
+        {
+            for(bool symmetric : { false, true })
+            {
+                RasterizerOptions reference;
+                reference.FixedPoint = fixedPoint;
+                reference.SymmetricTable = symmetric;
+                reference.Isa = KernelIsa::Scalar;
+                std::vector<uint8_t> expected = Render<RasterizerT>(reference, triangles);
+
+                for(bool hierarchical : { false, true })
+                {
+                    for(bool rowSpans : { false, true })
+                    {
+                        RasterizerOptions options = reference;
+                        options.HierarchicalTraversal = hierarchical;
+                        options.RowSpans = rowSpans;
+                        Check(Render<RasterizerT>(options, triangles) == expected, "traversal options draw the same pixels");
+                    }
+                }
+
+                for(KernelIsa isa : { KernelIsa::Scalar, KernelIsa::SSE42, KernelIsa::AVX2, KernelIsa::AVX512 })
+                {
+                    if(!RasterKernels::IsSupported(isa, cpu))
+                    {
+                        continue;
+                    }
+                    // The gather and tile expansion kernels only exist for 8x8 tiles
+                    RasterizerOptions request = reference;
+                    request.Isa = isa;
+                    bool sse42Fallback = RasterizerT::GridSize != 8 && isa != KernelIsa::Scalar;
+                    Check(RasterizerT(Width, Height, request).GetKernelIsa() == (sse42Fallback ? KernelIsa::SSE42 : isa), "the requested kernel set is used");
+                    for(FrameBufferLayout layout : { FrameBufferLayout::Linear, FrameBufferLayout::Tiled, FrameBufferLayout::Coverage })
+                    {
+                        RasterizerOptions options = reference;
+                        options.Isa = isa;
+                        options.Layout = layout;
+                        Check(Render<RasterizerT>(options, triangles) == expected, "kernel sets and layouts draw the same pixels");
+                        options.Threads = 4;
+                        options.Parallel = ParallelMode::SortMiddle;
+                        Check(Render<RasterizerT>(options, triangles) == expected, "SortMiddle draws the same pixels");
+                        options.Parallel = ParallelMode::SortLast;
+                        Check(Render<RasterizerT>(options, triangles) == expected, "SortLast draws the same pixels");
+                        options.SplitTiles = 16; // most triangles go through the split strips
+                        Check(Render<RasterizerT>(options, triangles) == expected, "SortLast with split triangles draws the same pixels");
+                    }
+                }
+            }
+        }
+    }
+
+    // Vertices of a random walk, so the triangles between neighbours stay small
+    std::vector<glm::vec4> RandomWalk(int count, unsigned seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> step(-0.15f, 0.15f);
+        std::uniform_real_distribution<float> depth(-0.5f, 0.5f);
+        std::vector<glm::vec4> vertices;
+        float x = 0.0f, y = 0.0f;
+        for(int i = 0; i < count; ++i)
+        {
+            x = std::clamp(x + step(rng), -1.1f, 1.1f);
+            y = std::clamp(y + step(rng), -1.1f, 1.1f);
+            vertices.emplace_back(x, y, depth(rng), 1.0f);
+        }
+        return vertices;
+    }
+
+    // Draws the triangles of corners(i, index) once as a list and once through draw, from the
+    // same clip-space vertices and in NDC, and checks they give the same pixels
+    template <typename Corners, typename DrawStreams, typename DrawNdc>
+    void CheckMatchesList(const std::vector<glm::vec4> &vertices, int triangles, Corners &&corners,
+                          DrawStreams &&drawStreams, DrawNdc &&drawNdc, const char *what)
+    {
+        // Some perspective, w from 0.85 to 1.15, and no triangle near the near plane
+        glm::mat4 mvp(1.0f);
+        mvp[0][0] = 0.9f;
+        mvp[3][1] = 0.05f;
+        mvp[2][3] = 0.3f;
+        std::vector<glm::vec4> list;
+        std::vector<glm::vec3> ndc, ndcList;
+        for(const glm::vec4 &v : vertices)
+        {
+            ndc.emplace_back(v.x, v.y, v.z);
+        }
+        for(int i = 0; i < triangles; ++i)
+        {
+            int index[3];
+            corners(i, index);
+            for(int k : index)
+            {
+                list.push_back(vertices[k]);
+                ndcList.push_back(ndc[k]);
+            }
+        }
+        Streams streams(vertices);
+        Streams listStreams(list);
+        for(bool fixedPoint : { false, true })
+        {
+            for(int threads : { 1, 4 })
+            {
+                RasterizerOptions options;
+                options.FixedPoint = fixedPoint;
+                options.Threads = threads;
+                Rasterizer expected(Width, Height, options);
+                expected.RasterizeStreams(listStreams.View(), mvp);
+                Rasterizer actual(Width, Height, options);
+                drawStreams(actual, streams.View(), mvp);
+                Check(actual.GetLinearFrameBuffer() == expected.GetLinearFrameBuffer(), what);
+
+                Rasterizer expectedNdc(Width, Height, options);
+                expectedNdc.RasterizePrototype3(ndcList);
+                Rasterizer actualNdc(Width, Height, options);
+                drawNdc(actualNdc, ndc);
+                Check(actualNdc.GetLinearFrameBuffer() == expectedNdc.GetLinearFrameBuffer(), what);
+            }
+        }
+    }
+
+    // Indexed, strip and fan draws are the list draws of the triangles they describe
+    void TestIndexedDrawsMatchLists()
+    {
+        std::vector<glm::vec4> vertices = RandomWalk(400, 6);
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> near(-6, 6);
+        std::vector<uint32_t> indices;
+        for(int i = 0; i < 1200; ++i)
+        {
+            indices.push_back(static_cast<uint32_t>(std::clamp(i / 3 + near(rng), 0, 399)));
+        }
+        std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+        int triangles = static_cast<int>(indices.size() / 3);
+
+        CheckMatchesList(vertices, triangles,
+            [&](int i, int index[3]) { for(int k = 0; k < 3; ++k) index[k] = static_cast<int>(indices[i * 3 + k]); },
+            [&](Rasterizer &r, const VertexStreams &v, const glm::mat4 &mvp) { r.RasterizeIndexed(v, indices, mvp); },
+            [&](Rasterizer &r, const std::vector<glm::vec3> &v) { r.RasterizeIndexed(v, indices); },
+            "RasterizeIndexed matches the list draw");
+        CheckMatchesList(vertices, triangles,
+            [&](int i, int index[3]) { for(int k = 0; k < 3; ++k) index[k] = shortIndices[i * 3 + k]; },
+            [&](Rasterizer &r, const VertexStreams &v, const glm::mat4 &mvp) { r.RasterizeIndexed(v, shortIndices, mvp); },
+            [&](Rasterizer &r, const std::vector<glm::vec3> &v) { r.RasterizeIndexed(v, shortIndices); },
+            "RasterizeIndexed with 16-bit indices matches the list draw");
+        // Odd triangles of a strip swap their first two corners to keep the winding
+        CheckMatchesList(vertices, static_cast<int>(vertices.size()) - 2,
+            [](int i, int index[3]) { index[0] = i + (i & 1); index[1] = i + 1 - (i & 1); index[2] = i + 2; },
+            [](Rasterizer &r, const VertexStreams &v, const glm::mat4 &mvp) { r.RasterizeStrip(v, mvp); },
+            [](Rasterizer &r, const std::vector<glm::vec3> &v) { r.RasterizeStrip(v); },
+            "RasterizeStrip matches the list draw");
+        std::vector<glm::vec4> fan = RandomWalk(60, 8);
+        CheckMatchesList(fan, static_cast<int>(fan.size()) - 2,
+            [](int i, int index[3]) { index[0] = 0; index[1] = i + 1; index[2] = i + 2; },
+            [](Rasterizer &r, const VertexStreams &v, const glm::mat4 &mvp) { r.RasterizeFan(v, mvp); },
+            [](Rasterizer &r, const std::vector<glm::vec3> &v) { r.RasterizeFan(v); },
+            "RasterizeFan matches the list draw");
+    }
+
+    // The tables written to TableCachePath on a miss and mapped back on the next run draw the
+    // same pixels as the built-in ones. Truncated or damaged files are written again, and a path
+    // that cannot be written falls back to the built-in tables.
+    void TestTableCacheRoundTrip()
+    {
+        std::vector<glm::vec3> triangles = RandomTriangles(300, 9, false);
+        std::filesystem::path directory = std::filesystem::temp_directory_path() / "rasterizer_tests";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        for(bool symmetric : { false, true })
+        {
+            RasterizerOptions options;
+            options.SymmetricTable = symmetric;
+            std::vector<uint8_t> expected = Render(options, triangles);
+            options.TableCachePath = (directory / (symmetric ? "symmetric.bin" : "tables.bin")).string();
+            {
+                Rasterizer written(Width, Height, options);
+                Check(written.IsTableFileMapped() && std::filesystem::exists(options.TableCachePath), "a missing table cache is written");
+                written.RasterizePrototype3(triangles);
+                Check(written.GetLinearFrameBuffer() == expected, "written table cache draws like the built-in tables");
+            }
+            // The first rasterizer released the mapping, so this one loads the file again
+            auto writeTime = std::filesystem::last_write_time(options.TableCachePath);
+            {
+                Rasterizer loaded(Width, Height, options);
+                Check(loaded.IsTableFileMapped() && std::filesystem::last_write_time(options.TableCachePath) == writeTime, "an existing table cache is loaded");
+                loaded.RasterizePrototype3(triangles);
+                Check(loaded.GetLinearFrameBuffer() == expected, "loaded table cache draws like the built-in tables");
+            }
+            // A truncated file fails validation and is written again
+            std::filesystem::resize_file(options.TableCachePath, 100);
+            {
+                Rasterizer rewritten(Width, Height, options);
+                Check(rewritten.IsTableFileMapped() && std::filesystem::file_size(options.TableCachePath) > 100, "a broken table cache is written again");
+                rewritten.RasterizePrototype3(triangles);
+                Check(rewritten.GetLinearFrameBuffer() == expected, "rewritten table cache draws like the built-in tables");
+            }
+            // A flipped payload byte fails the payload hash and the file is written again
+            auto flipped = static_cast<std::streamoff>(std::filesystem::file_size(options.TableCachePath) / 2);
+            char original = 0;
+            {
+                std::fstream file(options.TableCachePath, std::ios::in | std::ios::out | std::ios::binary);
+                file.seekg(flipped);
+                file.get(original);
+                file.seekp(flipped);
+                file.put(static_cast<char>(~original));
+            }
+            {
+                Rasterizer repaired(Width, Height, options);
+                std::ifstream file(options.TableCachePath, std::ios::binary);
+                char restored = 0;
+                file.seekg(flipped);
+                file.get(restored);
+                Check(repaired.IsTableFileMapped() && restored == original, "a damaged table cache is written again");
+                repaired.RasterizePrototype3(triangles);
+                Check(repaired.GetLinearFrameBuffer() == expected, "repaired table cache draws like the built-in tables");
+            }
+            options.TableCachePath = (directory / "missing" / "tables.bin").string();
+            Rasterizer fallback(Width, Height, options);
+            Check(!fallback.IsTableFileMapped(), "an unusable table cache path is reported");
+            fallback.RasterizePrototype3(triangles);
+            Check(fallback.GetLinearFrameBuffer() == expected, "an unusable table cache path falls back to the built-in tables");
+        }
+        std::filesystem::remove_all(directory);
+    }
+
+    // Resize between draws keeps the kernels and the shared table mapping bound. Every size must
+    // draw what a new rasterizer of that size draws, also after the other holder of the mapping
+    // is gone.
+    void TestResize()
+    {
+        std::vector<glm::vec3> triangles = RandomTriangles(300, 11, false);
+        std::filesystem::path directory = std::filesystem::temp_directory_path() / "rasterizer_tests";
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        for(FrameBufferLayout layout : { FrameBufferLayout::Linear, FrameBufferLayout::Tiled, FrameBufferLayout::Coverage })
+        {
+            RasterizerOptions options;
+            options.Layout = layout;
+            options.TableCachePath = (directory / "tables.bin").string();
+            auto other = std::make_unique<Rasterizer>(Width, Height, options);
+            auto writeTime = std::filesystem::last_write_time(options.TableCachePath);
+            Rasterizer resized(Width, Height, options);
+            other.reset();
+
+            RasterizerOptions builtIn = options;
+            builtIn.TableCachePath.clear();
+            const int32_t sizes[][2] = { { Width, Height }, { 1920, 1080 }, { 333, 517 }, { Width, Height } };
+            for(const int32_t *size : sizes)
+            {
+                resized.Resize(size[0], size[1]);
+                resized.RasterizePrototype3(triangles);
+                Rasterizer fresh(size[0], size[1], builtIn);
+                fresh.RasterizePrototype3(triangles);
+                Check(resized.GetLinearFrameBuffer() == fresh.GetLinearFrameBuffer(), "a resized rasterizer draws like a new one of that size");
+            }
+            Check(std::filesystem::last_write_time(options.TableCachePath) == writeTime, "the shared table cache is not written again");
+            std::filesystem::remove(options.TableCachePath);
+        }
+        std::filesystem::remove_all(directory);
+    }
+}
+
+int main()
+{
+    TestCoverageMatchesPrototype1<Rasterizer>();
+    TestCoverageMatchesPrototype1<BasicRasterizer<4, 64, 64>>();
+    TestCoverageMatchesPrototype1<BasicRasterizer<16, 64, 64>>();
+    TestFixedPointGuardBand();
+    TestHugeTriangleFillsScreen();
+    TestTriangleCounts();
+    TestStreamsFollowParallelMode();
+    TestKernelsMatch();
+    TestTileWritersMatch();
+    TestKernelSetsMatchScalar();
+    TestRenderPathsMatch<Rasterizer>();
+    TestRenderPathsMatch<BasicRasterizer<4, 64, 64>>();
+    TestRenderPathsMatch<BasicRasterizer<16, 64, 64>>();
+    TestIndexedDrawsMatchLists();
+    TestTableCacheRoundTrip();
+    TestResize();
+    TestOffsetsMatchTileLoop();
+    if(gFailures)
+    {
+        std::printf("%d checks failed\n", gFailures);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,205 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+// Fixed set of worker threads running one ParallelFor at a time. The calling thread joins in,
+// so a pool of N workers has N + 1 participants, numbered 0 (the caller) to N. Scheduling is
+// work-stealing over index ranges: every participant starts on a contiguous share of the
+// indices and runs it front to back, one that runs dry steals the back half of the largest
+// remaining share.
+class ThreadPool
+{
+    public:
+        // 0 uses one participant per hardware thread
+        explicit ThreadPool(int participants)
+        {
+            if(participants <= 0)
+            {
+                participants = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+            }
+            mRanges = std::vector<Range>(participants);
+            for(int i = 1; i < participants; ++i)
+            {
+                mWorkers.emplace_back([this, i] { WorkerLoop(i); });
+            }
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mStop = true;
+            }
+            mWake.notify_all();
+            for(std::thread &worker : mWorkers)
+            {
+                worker.join();
+            }
+        }
+
+        int Participants() const
+        {
+            return static_cast<int>(mWorkers.size()) + 1;
+        }
+
+        // Calls func(index, participant) for every index in [0, count). Returns once all calls
+        // have finished.
+        void ParallelFor(int count, const std::function<void(int, int)> &func)
+        {
+            if(count <= 0)
+            {
+                return;
+            }
+            if(mWorkers.empty() || count == 1)
+            {
+                for(int i = 0; i < count; ++i)
+                {
+                    func(i, 0);
+                }
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mFunc = &func;
+                int participants = Participants();
+                for(int p = 0; p < participants; ++p)
+                {
+                    uint32_t begin = static_cast<uint32_t>(static_cast<int64_t>(count) * p / participants);
+                    uint32_t end = static_cast<uint32_t>(static_cast<int64_t>(count) * (p + 1) / participants);
+                    mRanges[p].Bounds.store(Pack(begin, end), std::memory_order_relaxed);
+                }
+                mBusy = static_cast<int>(mWorkers.size());
+                ++mGeneration;
+            }
+            mWake.notify_all();
+            RunItems(0);
+            std::unique_lock<std::mutex> lock(mMutex);
+            mDone.wait(lock, [this] { return mBusy == 0; });
+            mFunc = nullptr;
+        }
+
+    private:
+        // [begin, end) of one participant's share, begin in the high half
+        struct Range
+        {
+            alignas(64) std::atomic<uint64_t> Bounds{ 0 };
+        };
+
+        static uint64_t Pack(uint32_t begin, uint32_t end)
+        {
+            return static_cast<uint64_t>(begin) << 32 | end;
+        }
+
+        // Takes the front index of the share, false once it is empty
+        static bool PopFront(Range &range, uint32_t &index)
+        {
+            uint64_t bounds = range.Bounds.load(std::memory_order_relaxed);
+            for(;;)
+            {
+                uint32_t begin = static_cast<uint32_t>(bounds >> 32);
+                uint32_t end = static_cast<uint32_t>(bounds);
+                if(begin >= end)
+                {
+                    return false;
+                }
+                if(range.Bounds.compare_exchange_weak(bounds, Pack(begin + 1, end), std::memory_order_relaxed))
+                {
+                    index = begin;
+                    return true;
+                }
+            }
+        }
+
+        // Moves the back half of the largest other share into the participant's own, which is empty
+        bool Steal(int participant)
+        {
+            for(;;)
+            {
+                int victim = -1;
+                uint32_t largest = 0;
+                for(int p = 0; p < static_cast<int>(mRanges.size()); ++p)
+                {
+                    uint64_t bounds = mRanges[p].Bounds.load(std::memory_order_relaxed);
+                    uint32_t begin = static_cast<uint32_t>(bounds >> 32);
+                    uint32_t end = static_cast<uint32_t>(bounds);
+                    if(p != participant && end > begin && end - begin > largest)
+                    {
+                        victim = p;
+                        largest = end - begin;
+                    }
+                }
+                if(victim < 0)
+                {
+                    return false;
+                }
+                uint64_t bounds = mRanges[victim].Bounds.load(std::memory_order_relaxed);
+                uint32_t begin = static_cast<uint32_t>(bounds >> 32);
+                uint32_t end = static_cast<uint32_t>(bounds);
+                if(begin >= end)
+                {
+                    continue;
+                }
+                uint32_t middle = begin + (end - begin) / 2;
+                if(mRanges[victim].Bounds.compare_exchange_strong(bounds, Pack(begin, middle), std::memory_order_relaxed))
+                {
+                    mRanges[participant].Bounds.store(Pack(middle, end), std::memory_order_relaxed);
+                    return true;
+                }
+            }
+        }
+
+        void RunItems(int participant)
+        {
+            Range &own = mRanges[participant];
+            do
+            {
+                uint32_t index;
+                while(PopFront(own, index))
+                {
+                    (*mFunc)(static_cast<int>(index), participant);
+                }
+            } while(Steal(participant));
+        }
+
+        void WorkerLoop(int participant)
+        {
+            uint64_t seen = 0;
+            for(;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mMutex);
+                    mWake.wait(lock, [&] { return mStop || mGeneration != seen; });
+                    if(mStop)
+                    {
+                        return;
+                    }
+                    seen = mGeneration;
+                }
+                RunItems(participant);
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    --mBusy;
+                }
+                mDone.notify_one();
+            }
+        }
+
+        std::vector<std::thread> mWorkers;
+        std::mutex mMutex;
+        std::condition_variable mWake;
+        std::condition_variable mDone;
+        const std::function<void(int, int)> *mFunc = nullptr;
+        std::vector<Range> mRanges; // per participant
+        int mBusy = 0;
+        uint64_t mGeneration = 0;
+        bool mStop = false;
+};